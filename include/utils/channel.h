@@ -7,7 +7,7 @@
 #ifndef _CHANNEL_H_
 #define _CHANNEL_H_
 
-#include <utils/hashmap.h>
+#include <utils/shard_map.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,10 +70,10 @@ struct channel {
 
 struct channel_manager {
 	int open_channels;
-	hash_map_t channels;
+	shard_map_t channels;
 };
 
-void channel_manager_init(struct channel_manager *ctx);
+int channel_manager_init(struct channel_manager *ctx);
 
 enum channel_type channel_guess_type(const char *desc);
 
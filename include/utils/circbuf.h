@@ -7,17 +7,25 @@
 #ifndef _UTIL_CIRCBUF_H_
 #define _UTIL_CIRCBUF_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /** --- Internal methods and structures. DON'T USE --------------------------- */
+
+/**
+ * When size is a power of 2, push/pop counts run free and wrap around on
+ * their own; the slot is the count masked with size - 1. For other sizes
+ * they run over [0, 2 * size) so that full and empty still differ.
+ */
 typedef struct {
 	void * const buffer;
-	int push_count;
-	int pop_count;
+	unsigned int push_count;
+	unsigned int pop_count;
 	int const size;
 	int const element_size;
 } circbuf_t;
@@ -35,6 +43,97 @@ typedef struct {
 int __circbuf_push(circbuf_t *circbuf, void *elem);
 int __circbuf_pop (circbuf_t *circbuf, void *elem, int read_only);
 int __circbuf_free_space(circbuf_t *circbuf);
+int __circbuf_push_n(circbuf_t *circbuf, const void *elems, int count);
+int __circbuf_pop_n (circbuf_t *circbuf, void *elems, int count);
+int __circbuf_write_reserve(circbuf_t *circbuf, void **ptr);
+int __circbuf_write_commit (circbuf_t *circbuf, int count);
+int __circbuf_read_reserve (circbuf_t *circbuf, void **ptr);
+int __circbuf_read_commit  (circbuf_t *circbuf, int count);
+
+#define __CIRCBUF_IS_POW2(sz)	((sz) > 0 && ((sz) & ((sz) - 1)) == 0)
+
+/* slot for a free running position */
+static inline size_t __circbuf_wrap(size_t pos, size_t size)
+{
+	return __CIRCBUF_IS_POW2(size) ? pos & (size - 1) : pos % size;
+}
+
+/**
+ * Power of 2 fast path of __circbuf_push/__circbuf_pop. CIRCBUF_DEF passes
+ * size and element_size as constants so the mask and the memcpy fold into
+ * a couple of instructions at the call site.
+ */
+static inline int __circbuf_pow2_push(circbuf_t *circ_buf, const void *elem,
+				      unsigned int size, size_t element_size)
+{
+	unsigned int push_count = circ_buf->push_count;
+
+	if (push_count - circ_buf->pop_count >= size)
+		return -1; // Full
+
+	memcpy((char *)circ_buf->buffer + (push_count & (size - 1)) *
+	       element_size, elem, element_size);
+	circ_buf->push_count = push_count + 1;
+	return 0;
+}
+
+static inline int __circbuf_pow2_pop(circbuf_t *circ_buf, void *elem,
+				     int read_only, unsigned int size,
+				     size_t element_size)
+{
+	char *tail;
+	unsigned int pop_count = circ_buf->pop_count;
+
+	if (circ_buf->push_count == pop_count)
+		return -1; // Empty
+
+	tail = (char *)circ_buf->buffer + (pop_count & (size - 1)) *
+	       element_size;
+	if (elem)
+		memcpy(elem, tail, element_size);
+
+	if (!read_only) {
+#ifdef CRICBUF_CLEAN_ON_POP
+		memset(tail, 0, element_size);
+#endif
+		circ_buf->pop_count = pop_count + 1;
+	}
+	return 0;
+}
+
+#define __CIRCBUF_CACHE_LINE 64
+
+/**
+ * head/tail are free running counts of pops/pushes, each on a cache line of
+ * its own along with the side's cached copy of the other index so that the
+ * producer and consumer only touch each other's line when the cache says
+ * the ring is full/empty.
+ */
+typedef struct {
+	void * const buffer;
+	int const size;
+	int const element_size;
+
+	/* consumer */
+	size_t head __attribute__((aligned(__CIRCBUF_CACHE_LINE)));
+	size_t cached_tail;
+
+	/* producer */
+	size_t tail __attribute__((aligned(__CIRCBUF_CACHE_LINE)));
+	size_t cached_head;
+} __attribute__((aligned(__CIRCBUF_CACHE_LINE))) circbuf_spsc_t;
+
+#define __CIRCBUF_SPSC_VAR_DEF(type, buf, sz)		\
+	type buf ## _circbuf_data[sz];			\
+	circbuf_spsc_t buf = {				\
+		.buffer = buf ## _circbuf_data,		\
+		.size = sz,				\
+		.element_size = sizeof(type)		\
+	};
+
+int __circbuf_spsc_push(circbuf_spsc_t *circbuf, void *elem);
+int __circbuf_spsc_pop (circbuf_spsc_t *circbuf, void *elem, int read_only);
+int __circbuf_spsc_free_space(circbuf_spsc_t *circbuf);
 /* -------------------------------------------------------------------------- */
 
 /**
@@ -48,23 +147,61 @@ int __circbuf_free_space(circbuf_t *circbuf);
  *   Defines a global circular buffer `buf` of a given type and size. The type
  *   can be native data types or user-defined data types.
  *
+ *   Power of 2 sizes are faster: push/pop/peek then index the buffer with a
+ *   mask instead of wrapping the counts around by hand.
+ *
  * Usage:
  *   CIRCBUF_DEF(uint8_t, byte_buf, 13);
- *   CIRCBUF_DEF(struct foo, foo_buf, 10);
+ *   CIRCBUF_DEF(struct foo, foo_buf, 16);
+ */
+#define CIRCBUF_DEF(type, buf, size)					\
+	__CIRCBUF_VAR_DEF(type, buf, size)				\
+	int buf ## _push_refd(type *pt)					\
+	{								\
+		if (__CIRCBUF_IS_POW2(size))				\
+			return __circbuf_pow2_push(&buf, pt, size,	\
+						   sizeof(type));	\
+		return __circbuf_push(&buf, pt);			\
+	}								\
+	int buf ## _pop_refd(type *pt)					\
+	{								\
+		if (__CIRCBUF_IS_POW2(size))				\
+			return __circbuf_pow2_pop(&buf, pt, 0, size,	\
+						  sizeof(type));	\
+		return __circbuf_pop(&buf, pt, 0);			\
+	}								\
+	int buf ## _peek_refd(type *pt)					\
+	{								\
+		if (__CIRCBUF_IS_POW2(size))				\
+			return __circbuf_pow2_pop(&buf, pt, 1, size,	\
+						  sizeof(type));	\
+		return __circbuf_pop(&buf, pt, 1);			\
+	}
+
+/**
+ * Description:
+ *   Same as CIRCBUF_DEF but the buffer can be shared by exactly one producer
+ *   thread (push) and one consumer thread (pop/peek) without any locks. Both
+ *   sides are wait-free. CIRCBUF_PUSH, CIRCBUF_POP and CIRCBUF_PEEK work on
+ *   it as usual; use CIRCBUF_SPSC_FS and CIRCBUF_SPSC_FLUSH in place of
+ *   CIRCBUF_FS and CIRCBUF_FLUSH.
+ *
+ * Usage:
+ *   CIRCBUF_SPSC_DEF(uint8_t, rx_buf, 256);
  */
-#define CIRCBUF_DEF(type, buf, size)			\
-	__CIRCBUF_VAR_DEF(type, buf, size)		\
+#define CIRCBUF_SPSC_DEF(type, buf, size)		\
+	__CIRCBUF_SPSC_VAR_DEF(type, buf, size)		\
 	int buf ## _push_refd(type *pt)			\
 	{						\
-		return __circbuf_push(&buf, pt);	\
+		return __circbuf_spsc_push(&buf, pt);	\
 	}						\
 	int buf ## _pop_refd(type *pt)			\
 	{						\
-		return __circbuf_pop(&buf, pt, 0);	\
+		return __circbuf_spsc_pop(&buf, pt, 0);	\
 	}						\
 	int buf ## _peek_refd(type *pt)			\
 	{						\
-		return __circbuf_pop(&buf, pt, 1);	\
+		return __circbuf_spsc_pop(&buf, pt, 1);	\
 	}
 
 /**
@@ -121,6 +258,54 @@ int __circbuf_free_space(circbuf_t *circbuf);
  */
 #define CIRCBUF_FS(buf)                     __circbuf_free_space(&buf)
 
+/**
+ * Description:
+ *   Pushes up to `count` elements from the array `elems` into `buf` (or pops
+ *   up to `count` elements from `buf` into `elems`, which can be NULL to
+ *   drop them). Elements are moved with at most two memcpy calls.
+ *
+ * Returns (int):
+ *   0..count - number of elements pushed/popped; 0 when full/empty.
+ */
+#define CIRCBUF_PUSH_N(buf, elems, count)   __circbuf_push_n(&buf, elems, count)
+#define CIRCBUF_POP_N(buf, elems, count)    __circbuf_pop_n(&buf, elems, count)
+
+/**
+ * Description:
+ *   Zero-copy access to `buf`. CIRCBUF_WRITE_RESERVE points `ptr` (a void **)
+ *   at the head slot and returns how many free slots follow it without
+ *   wrapping around; the caller fills up to that many and publishes them
+ *   with CIRCBUF_WRITE_COMMIT. CIRCBUF_READ_RESERVE/CIRCBUF_READ_COMMIT do
+ *   the same for the filled slots at the tail.
+ *
+ * Usage:
+ *   n = CIRCBUF_WRITE_RESERVE(rx_buf, &p);
+ *   if (n > 0 && (len = read(fd, p, n)) > 0)
+ *       CIRCBUF_WRITE_COMMIT(rx_buf, len);
+ *
+ * Returns (int):
+ *   RESERVE: 0..N - number of contiguous slots available at `ptr`.
+ *   COMMIT:  0 - Success, -1 - `count` is more than is free/filled.
+ */
+#define CIRCBUF_WRITE_RESERVE(buf, ptr)     __circbuf_write_reserve(&buf, ptr)
+#define CIRCBUF_WRITE_COMMIT(buf, count)    __circbuf_write_commit(&buf, count)
+#define CIRCBUF_READ_RESERVE(buf, ptr)      __circbuf_read_reserve(&buf, ptr)
+#define CIRCBUF_READ_COMMIT(buf, count)     __circbuf_read_commit(&buf, count)
+
+/**
+ * Description:
+ *   CIRCBUF_FS and CIRCBUF_FLUSH for buffers defined with CIRCBUF_SPSC_DEF.
+ *   The free space seen by either side can be stale by the time it is used.
+ *   Flush must not race with a push or a pop.
+ */
+#define CIRCBUF_SPSC_FS(buf)                __circbuf_spsc_free_space(&buf)
+
+#define CIRCBUF_SPSC_FLUSH(buf)				\
+	do {						\
+		buf.head = buf.cached_tail = 0;		\
+		buf.tail = buf.cached_head = 0;		\
+	} while(0)
+
 #ifdef __cplusplus
 }
 #endif
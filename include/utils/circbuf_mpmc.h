@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _UTIL_CIRCBUF_MPMC_H_
+#define _UTIL_CIRCBUF_MPMC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/circbuf.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** --- Internal methods and structures. DON'T USE --------------------------- */
+
+/**
+ * Bounded multi producer/multi consumer ring after Dmitry Vyukov. Each slot
+ * carries a sequence number that says whether it is ready for the push or
+ * the pop at a given position; producers and consumers claim positions
+ * with a CAS on tail/head and then hand the slot over by bumping its
+ * sequence. Sequences are stored relative to the slot index so that a
+ * zeroed (static) buffer is a valid empty one.
+ */
+typedef struct {
+	void * const buffer;
+	int const size;
+	int const element_size;
+	int const slot_size;
+	int const data_offset;
+
+	/* consumers */
+	size_t head __attribute__((aligned(__CIRCBUF_CACHE_LINE)));
+
+	/* producers */
+	size_t tail __attribute__((aligned(__CIRCBUF_CACHE_LINE)));
+} __attribute__((aligned(__CIRCBUF_CACHE_LINE))) circbuf_mpmc_t;
+
+#define __CIRCBUF_MPMC_VAR_DEF(type, buf, sz)				\
+	struct buf ## _circbuf_slot {					\
+		size_t seq;						\
+		type data;						\
+	};								\
+	struct buf ## _circbuf_slot buf ## _circbuf_data[sz];		\
+	circbuf_mpmc_t buf = {						\
+		.buffer = buf ## _circbuf_data,				\
+		.size = sz,						\
+		.element_size = sizeof(type),				\
+		.slot_size = sizeof(struct buf ## _circbuf_slot),	\
+		.data_offset = offsetof(struct buf ## _circbuf_slot, data) \
+	};
+
+int __circbuf_mpmc_push(circbuf_mpmc_t *circbuf, void *elem);
+int __circbuf_mpmc_pop (circbuf_mpmc_t *circbuf, void *elem);
+int __circbuf_mpmc_free_space(circbuf_mpmc_t *circbuf);
+void __circbuf_mpmc_flush(circbuf_mpmc_t *circbuf);
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Description:
+ *   Same as CIRCBUF_DEF but any number of threads can push and pop
+ *   concurrently without locks. CIRCBUF_PUSH and CIRCBUF_POP work on it as
+ *   usual. There is no peek as the element could be gone by the time the
+ *   caller acts on it.
+ *
+ * Usage:
+ *   CIRCBUF_MPMC_DEF(work_t *, backlog, 128);
+ */
+#define CIRCBUF_MPMC_DEF(type, buf, size)		\
+	__CIRCBUF_MPMC_VAR_DEF(type, buf, size)		\
+	int buf ## _push_refd(type *pt)			\
+	{						\
+		return __circbuf_mpmc_push(&buf, pt);	\
+	}						\
+	int buf ## _pop_refd(type *pt)			\
+	{						\
+		return __circbuf_mpmc_pop(&buf, pt);	\
+	}
+
+/**
+ * Description:
+ *   Number of free slots in `buf`; only a hint while other threads are
+ *   pushing or popping.
+ */
+#define CIRCBUF_MPMC_FS(buf)                __circbuf_mpmc_free_space(&buf)
+
+/**
+ * Description:
+ *   Empties `buf`. Must not race with a push or a pop.
+ */
+#define CIRCBUF_MPMC_FLUSH(buf)             __circbuf_mpmc_flush(&buf)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_CIRCBUF_MPMC_H_ */
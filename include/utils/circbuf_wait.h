@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _UTIL_CIRCBUF_WAIT_H_
+#define _UTIL_CIRCBUF_WAIT_H_
+
+#include <utils/circbuf.h>
+#include <utils/event.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** --- Internal methods and structures. DON'T USE --------------------------- */
+
+#define __CIRCBUF_WAIT_PRODUCER		0x01
+#define __CIRCBUF_WAIT_CONSUMER		0x02
+
+/**
+ * A circbuf_spsc_t with an event for each side to sleep on. Before going to
+ * sleep, a side sets its bit in `waiting` and tries once more; after each
+ * push/pop the other side sets the event only if that bit is set. So a
+ * busy ring never touches the events and a wakeup happens only when the
+ * sleeper's side went empty (consumer) or full (producer).
+ */
+typedef struct {
+	circbuf_spsc_t * const ring;
+	event_t not_empty;
+	event_t not_full;
+	int waiting;
+} circbuf_wait_t;
+
+int __circbuf_wait_init(circbuf_wait_t *w);
+void __circbuf_wait_cleanup(circbuf_wait_t *w);
+int __circbuf_wait_push(circbuf_wait_t *w, void *elem, int timeout_ms);
+int __circbuf_wait_pop (circbuf_wait_t *w, void *elem, int timeout_ms);
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Description:
+ *   Same as CIRCBUF_SPSC_DEF, but the producer can block while `buf` is
+ *   full and the consumer while it is empty (CIRCBUF_PUSH_WAIT and
+ *   CIRCBUF_POP_WAIT). CIRCBUF_PUSH, CIRCBUF_POP and CIRCBUF_PEEK don't
+ *   block. CIRCBUF_SPSC_FS and CIRCBUF_SPSC_FLUSH apply too. The buffer
+ *   must be set up with CIRCBUF_WAIT_INIT before use.
+ *
+ * Usage:
+ *   CIRCBUF_WAIT_DEF(struct msg, inbox, 64);
+ */
+#define CIRCBUF_WAIT_DEF(type, buf, size)				\
+	__CIRCBUF_SPSC_VAR_DEF(type, buf, size)				\
+	circbuf_wait_t buf ## _wait = { .ring = &buf };			\
+	int buf ## _push_wait(type *pt, int timeout_ms)			\
+	{								\
+		return __circbuf_wait_push(&buf ## _wait, pt, timeout_ms); \
+	}								\
+	int buf ## _pop_wait(type *pt, int timeout_ms)			\
+	{								\
+		return __circbuf_wait_pop(&buf ## _wait, pt, timeout_ms); \
+	}								\
+	int buf ## _push_refd(type *pt)					\
+	{								\
+		return __circbuf_wait_push(&buf ## _wait, pt, 0);	\
+	}								\
+	int buf ## _pop_refd(type *pt)					\
+	{								\
+		return __circbuf_wait_pop(&buf ## _wait, pt, 0);	\
+	}								\
+	int buf ## _peek_refd(type *pt)					\
+	{								\
+		return __circbuf_spsc_pop(&buf, pt, 1);			\
+	}
+
+/**
+ * Description:
+ *   Sets up/releases the events of a buffer defined with CIRCBUF_WAIT_DEF.
+ *
+ * Returns (int):
+ *   0 - Success
+ *  -1 - Failure
+ */
+#define CIRCBUF_WAIT_INIT(buf)              __circbuf_wait_init(&buf ## _wait)
+#define CIRCBUF_WAIT_CLEANUP(buf)           __circbuf_wait_cleanup(&buf ## _wait)
+
+/**
+ * Description:
+ *   CIRCBUF_PUSH/CIRCBUF_POP that wait up to `timeout_ms` milliseconds (-1
+ *   for ever) for a free slot/an element.
+ *
+ * Returns (int):
+ *   0 - Success
+ *  -1 - Timed out while full/empty
+ */
+#define CIRCBUF_PUSH_WAIT(buf, elem, timeout_ms)  buf ## _push_wait(elem, timeout_ms)
+#define CIRCBUF_POP_WAIT(buf, elem, timeout_ms)   buf ## _pop_wait(elem, timeout_ms)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_CIRCBUF_WAIT_H_ */
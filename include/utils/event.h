@@ -25,6 +25,14 @@ void event_cleanup(event_t *e);
 bool event_set(event_t *e);
 bool event_is_set(event_t *e);
 
+/**
+ * @brief Wait up to `timeout_ms` (-1 for ever) for `e` to be set and clear
+ * it. When more than one thread waits on `e`, it must be non-blocking.
+ *
+ * @return 1 when set, 0 on timeout, -1 on errors
+ */
+int event_wait(event_t *e, int timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -11,6 +11,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include <utils/memory.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -21,6 +23,7 @@ int write_binary_file(const char *path, uint8_t *buf, size_t size);
 int file_read_all(FILE *in, char **dataptr, size_t *sizeptr);
 char *get_working_directory(void);
 char *path_join(const char *p1, const char *p2);
+char *path_join_arena(arena_t *arena, const char *p1, const char *p2);
 bool file_exists(const char *path);
 int is_regular_file(const char *path);
 int path_extract(const char *path, char **dir_name, char **base_name);
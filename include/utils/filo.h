@@ -29,19 +29,33 @@ typedef struct {
                      .max_size = sz \
                   }; \
 
+/*
+ * The accessors work on the typed array directly so that the element size
+ * and the bound are compile time constants; filo_push/filo_pop are for
+ * filos set up at runtime with filo_init/filo_alloc.
+ */
 #define FILO_DEF(name, type, sz) \
     __FILO_DEF(name, type, sz) \
     int __## name ## _push(const type *elem) \
     { \
-        return filo_push(&name, (void *)elem); \
+        if (name.top >= (sz)) \
+            return -1; \
+        name ## _buffer[name.top++] = *elem; \
+        return 0; \
     } \
     int __## name ## _pop(type *elem) \
     { \
-        return filo_pop(&name, (void *)elem, true); \
+        if (name.top == 0) \
+            return -1; \
+        *elem = name ## _buffer[--name.top]; \
+        return 0; \
     } \
     int __## name ## _peek(type *elem) \
     { \
-        return filo_pop(&name, (void *)elem, false); \
+        if (name.top == 0) \
+            return -1; \
+        *elem = name ## _buffer[name.top - 1]; \
+        return 0; \
     } \
     unsigned __## name ## _get_count(void) \
     { \
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <utils/memory.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,19 +25,256 @@ struct hash_map_item_s {
 	void *val;
 };
 
+enum hash_map_type {
+	HASH_MAP_TYPE_CHAINED,
+	HASH_MAP_TYPE_OPEN,
+	HASH_MAP_TYPE_ORDERED,
+	HASH_MAP_TYPE_SENTINEL
+};
+
+enum hash_map_key_type {
+	HASH_MAP_KEY_STRING,
+	HASH_MAP_KEY_U64,
+	HASH_MAP_KEY_BINARY,
+};
+
+#define HASH_MAP_FLAG_NONE                 0x00000000
+#define HASH_MAP_FLAG_INCREMENTAL_REHASH   0x00000001
+#define HASH_MAP_FLAG_BORROW_KEYS          0x00000002
+#define HASH_MAP_FLAG_RANDOM_SEED          0x00000004
+#define HASH_MAP_FLAG_READ_MOSTLY          0x00000008
+#define HASH_MAP_FLAG_ARENA                0x00000010
+
+/**
+ * @brief Hash function used by a map. `len` is the size of the key in bytes
+ * (strlen() for STRING keys) and `seed` is hash_map_config_t::seed.
+ */
+typedef hash_t (*hash_map_hash_fn_t)(const void *key, size_t len, uint64_t seed);
+
+/* hash_map_hash_fn_t implementations shipped with the library */
+hash_t hash_map_hash_wy(const void *key, size_t len, uint64_t seed);
+hash_t hash_map_hash_crc32c(const void *key, size_t len, uint64_t seed);
+
+struct hash_map_rcu;
+
 typedef struct {
 	hash_map_item_t **pool;
 	size_t capacity;
 	size_t count;
+	enum hash_map_type type;
+	uint32_t flags;
+	enum hash_map_key_type key_type;
+	size_t key_len;
+	hash_map_hash_fn_t hash_fn;
+	uint64_t seed;
+	double load_factor;
+	double shrink_factor;
+
+	/* HASH_MAP_FLAG_INCREMENTAL_REHASH: buckets yet to be moved to pool */
+	hash_map_item_t **old_pool;
+	size_t old_capacity;
+	size_t migrate_pos;
+
+	/* HASH_MAP_TYPE_OPEN: control bytes, hashes and slots for each index */
+	uint8_t *ctrl;
+	hash_t *hashes;
+	void *slots;
+	size_t slot_size;
+	size_t deleted;
+
+	/* HASH_MAP_TYPE_ORDERED: hash index into the (ctrl, hashes, slots) entries */
+	uint32_t *index;
+	size_t nr_entries;
+	size_t max_entries;
+
+	/* HASH_MAP_FLAG_READ_MOSTLY: writer lock, published pool, retired items */
+	struct hash_map_rcu *rcu;
+
+	/* HASH_MAP_FLAG_ARENA: backing store for items and keys */
+	arena_t arena;
 } hash_map_t;
 
+/**
+ * @brief Per-map configuration passed to hash_map_init_config(). A zero
+ * initialized config yields the same map as hash_map_init().
+ *
+ * @param type Storage engine behind the map:
+ *   HASH_MAP_TYPE_CHAINED - bucket array with a linked list of items per
+ *                           bucket (default).
+ *   HASH_MAP_TYPE_OPEN    - open addressing with one control byte per slot
+ *                           (SwissTable style) and the hashes, keys and
+ *                           values held in contiguous arrays. No allocation
+ *                           is made per item, other than the copy of a
+ *                           STRING key.
+ *   HASH_MAP_TYPE_ORDERED - entries held back to back in insertion order
+ *                           with a separate hash index into them. Iterators
+ *                           walk the dense entries array (not the whole
+ *                           table) in insertion order, and any item can be
+ *                           deleted during iteration as entries don't move
+ *                           on delete (unless shrink_factor is set). The
+ *                           space of deleted entries is reclaimed when the
+ *                           entries array fills up or on hash_map_compact().
+ *
+ * @param flags Bitwise OR of HASH_MAP_FLAG_* below:
+ *   HASH_MAP_FLAG_INCREMENTAL_REHASH - (chained only) when the map has to
+ *       grow, keep the old bucket array around and move a few buckets into
+ *       the new one on each insert instead of all of them at once. Lookups,
+ *       deletes and iterators look in both arrays till the move completes.
+ *       This bounds the latency of the insert that crosses the density
+ *       threshold at the cost of a slightly slower map during the move.
+ *   HASH_MAP_FLAG_BORROW_KEYS - don't copy STRING or BINARY keys; the map
+ *       holds on to the pointer passed to hash_map_insert(). The caller must
+ *       keep the key alive and unmodified till it is deleted from the map.
+ *   HASH_MAP_FLAG_RANDOM_SEED - seed the hash function from the system's
+ *       random source instead of `seed`, so that colliding keys can't be
+ *       crafted ahead of time (hash flooding). Use this for maps that hold
+ *       untrusted keys. Implies hash_map_hash_wy() when hash_fn is NULL.
+ *   HASH_MAP_FLAG_READ_MOSTLY - (chained only) make the map safe to share
+ *       between threads, tuned for maps that are rarely written. Lookups
+ *       take no lock: writers serialize on a lock internal to the map and
+ *       publish new items and bucket arrays with atomic stores. Deleted
+ *       items (and the old bucket array after a rehash) are freed only
+ *       once every thread that could be looking at them has left its
+ *       lookup (epoch based reclamation). The map doesn't own values; a
+ *       value must outlive lookups that could still return it. Iterators
+ *       and hash_map_free() must not race with writers.
+ *   HASH_MAP_FLAG_ARENA - allocate items (chained) and key copies from an
+ *       arena owned by the map instead of one malloc() each. They are laid
+ *       out back to back in large chunks, and hash_map_free() releases the
+ *       chunks without visiting every item (when no callback is given). The
+ *       space of deleted items is not reused till hash_map_compact(), which
+ *       moves the live items into a new arena. Can't be combined with
+ *       HASH_MAP_FLAG_READ_MOSTLY.
+ *
+ * @param key_type What the `key` argument of hash_map_* methods points to:
+ *   HASH_MAP_KEY_STRING - a NUL terminated string (default).
+ *   HASH_MAP_KEY_U64    - a uint64_t; stored inline, no copy is allocated.
+ *                         See hash_map_insert_u64() and friends.
+ *   HASH_MAP_KEY_BINARY - `key_len` bytes, compared with memcmp(). Stored
+ *                         inline in the open addressing engine.
+ *
+ * @param key_len Size of keys for HASH_MAP_KEY_BINARY. Ignored otherwise.
+ *
+ * @param hash_fn Hash function for the keys of this map. When NULL, djb2 is
+ *   used for STRING keys (so hash32() of a key can be passed as key_hash),
+ *   a 64-bit mixer for U64 keys and FNV-1a for BINARY keys. The shipped
+ *   alternatives are:
+ *     hash_map_hash_wy     - wyhash; 8 bytes at a time, best all-rounder.
+ *     hash_map_hash_crc32c - CRC32C; uses the SSE4.2/ARMv8 CRC instructions
+ *                            when available. Not flooding resistant.
+ *
+ * @param seed Passed to hash_fn for every key.
+ *
+ * @param capacity Number of items the map is expected to hold. The table is
+ *   allocated large enough to take as many inserts without a rehash.
+ *
+ * @param load_factor Items per slot/bucket above which the table is doubled.
+ *   Defaults to 0.8; must be below 1 for HASH_MAP_TYPE_OPEN.
+ *
+ * @param shrink_factor When non-zero, a delete that leaves fewer than
+ *   shrink_factor items per slot/bucket shrinks the table to about half
+ *   load_factor. Can't be more than load_factor / 4. Off by default,
+ *   as deleting the item last returned by an iterator is only safe while
+ *   the table doesn't move under it.
+ */
+typedef struct {
+	enum hash_map_type type;
+	uint32_t flags;
+	enum hash_map_key_type key_type;
+	size_t key_len;
+	hash_map_hash_fn_t hash_fn;
+	uint64_t seed;
+	size_t capacity;
+	double load_factor;
+	double shrink_factor;
+} hash_map_config_t;
+
+/**
+ * @brief Callback for hash_map_free() (can be NULL). For non-STRING maps `key`
+ * points to the key bytes held by the map (and is not NUL terminated).
+ */
 typedef void (*hash_map_callback_t)(const char *key, void *val);
 
 void hash_map_init(hash_map_t *map);
+
+/**
+ * @brief Initialize `map` as described by `config`. The rest of the
+ * hash_map_* API is oblivious to the storage engine chosen here.
+ *
+ * @return -1 on errors
+ * @return  0 on success
+ */
+int hash_map_init_config(hash_map_t *map, const hash_map_config_t *config);
+
+/**
+ * @brief Same as hash_map_init() with a table sized for `capacity` items.
+ *
+ * @return -1 on errors
+ * @return  0 on success
+ */
+int hash_map_init_capacity(hash_map_t *map, size_t capacity);
+
+/**
+ * @brief Shrink the table to the smallest size that holds the current items
+ * within the load factor (dropping tombstones of the open addressing
+ * engine). Invalidates iterators.
+ */
+void hash_map_compact(hash_map_t *map);
+
 void hash_map_free(hash_map_t *map, hash_map_callback_t cb);
-hash_t hash_map_insert(hash_map_t *map, const char *key, void *val);
-void *hash_map_get(hash_map_t *map, const char *key, hash_t key_hash);
-void *hash_map_delete(hash_map_t *map, const char *key, hash_t key_hash);
+/**
+ * @brief Insert (or update) `key` with `val`.
+ *
+ * @return hash of `key`; can be passed as `key_hash` to get/delete.
+ */
+hash_t hash_map_insert(hash_map_t *map, const void *key, void *val);
+
+/**
+ * @brief Lookup/remove `key` from `map`. When `key` is NULL, the first item
+ * whose hash is `key_hash` is acted upon, else `key_hash` is ignored.
+ *
+ * @return value held for key or NULL when it was not found.
+ */
+void *hash_map_get(hash_map_t *map, const void *key, hash_t key_hash);
+void *hash_map_delete(hash_map_t *map, const void *key, hash_t key_hash);
+
+/**
+ * @brief Batch variants of hash_map_insert() and hash_map_get() for `count`
+ * keys; keys[i] is inserted with vals[i] / looked up into vals[i] (NULL when
+ * not found). Hashing and prefetching a batch ahead of resolving it hides
+ * the cache misses of independent lookups behind each other.
+ *
+ * @return (get_many) number of keys found.
+ */
+void hash_map_insert_many(hash_map_t *map, const void * const *keys,
+			  void * const *vals, size_t count);
+size_t hash_map_get_many(hash_map_t *map, const void * const *keys,
+			 void **vals, size_t count);
+
+/**
+ * @brief Hash of `key` as computed by `map`. The __hash_map_* variants below
+ * take this hash along with the key so that callers that have to look at the
+ * hash before reaching the map (see shard_map.h) don't hash a key twice.
+ */
+hash_t hash_map_hash(hash_map_t *map, const void *key);
+hash_t __hash_map_insert(hash_map_t *map, const void *key, hash_t hash, void *val);
+void *__hash_map_get(hash_map_t *map, const void *key, hash_t hash);
+void *__hash_map_delete(hash_map_t *map, const void *key, hash_t hash);
+
+static inline hash_t hash_map_insert_u64(hash_map_t *map, uint64_t key, void *val)
+{
+	return hash_map_insert(map, &key, val);
+}
+
+static inline void *hash_map_get_u64(hash_map_t *map, uint64_t key)
+{
+	return hash_map_get(map, &key, 0);
+}
+
+static inline void *hash_map_delete_u64(hash_map_t *map, uint64_t key)
+{
+	return hash_map_delete(map, &key, 0);
+}
 
 /* --- iterators --- */
 
@@ -8,6 +8,7 @@
 #define _UTILS_MEMORY_H_
 
 #include <stddef.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,6 +33,148 @@ void *safe_realloc(void *data, size_t size);
 void *safe_strdup(const char *s);
 void *safe_realloc_zero(void *data, size_t old_size, size_t new_size);
 
+/**
+ * @brief Allocate `size` bytes aligned to `align` (a power of 2, multiple of
+ * sizeof(void *)). The memory can be released with safe_free().
+ */
+void *safe_aligned_alloc(size_t align, size_t size);
+
+/**
+ * @brief Map `size` bytes (rounded up to HUGE_PAGE_SIZE) of zero filled,
+ * HUGE_PAGE_SIZE aligned memory for use as a slab_init() blob or the backing
+ * store of other pools. On Linux, hugetlbfs pages (MAP_HUGETLB) are tried
+ * first, then regular pages marked with MADV_HUGEPAGE so that transparent
+ * huge pages can back them. When `numa_node` >= 0, the pages are bound to
+ * that node with mbind(2); binding is best effort. Other platforms get
+ * safe_aligned_alloc(). Exits on OOM like the safe_* methods.
+ *
+ * The memory must be released with huge_page_free() with the same `size`.
+ */
+#define HUGE_PAGE_SIZE                (2 * 1024 * 1024)
+
+void *huge_page_alloc(size_t size, int numa_node);
+void huge_page_free(void *p, size_t size);
+
+/**
+ * @brief Allocation statistics. When built with USE_MEMORY_STATS (the whole
+ * library and its users), the safe_* alloc methods above become macros that
+ * record the file:line they were called from. Each call site keeps counts,
+ * live/total bytes and a histogram of request sizes; global live and peak
+ * bytes are kept as well. Memory from safe_* must then only be released
+ * through safe_free() as each block carries a small header.
+ *
+ * Without USE_MEMORY_STATS, memory_stats_get() returns -1 and
+ * memory_stats_dump() prints nothing.
+ */
+#define MEMORY_STATS_NR_BUCKETS       16
+
+typedef struct {
+	size_t nr_allocs;
+	size_t nr_frees;
+	size_t live_bytes;
+	size_t peak_bytes;
+	size_t total_bytes;
+} memory_stats_t;
+
+int memory_stats_get(memory_stats_t *stats);
+
+/**
+ * @brief Write global stats and one line per call site to `fp`.
+ * Histogram bucket `i` counts requests of up to 16 << i bytes; the last
+ * one counts everything larger.
+ */
+void memory_stats_dump(FILE *fp);
+
+#ifdef USE_MEMORY_STATS
+
+typedef struct memory_site_s {
+	const char *file;
+	int line;
+	int registered;
+	struct memory_site_s *next;
+	memory_stats_t stats;
+	size_t histogram[MEMORY_STATS_NR_BUCKETS];
+} memory_site_t;
+
+void *__safe_malloc(size_t size, memory_site_t *site);
+void *__safe_calloc(size_t count, size_t size, memory_site_t *site);
+void *__safe_realloc(void *data, size_t size, memory_site_t *site);
+void *__safe_strdup(const char *s, memory_site_t *site);
+void *__safe_realloc_zero(void *data, size_t old_size, size_t new_size,
+			  memory_site_t *site);
+void *__safe_aligned_alloc(size_t align, size_t size, memory_site_t *site);
+
+#define MEMORY_SITE_CALL(fn, ...) ({                                        \
+		static memory_site_t __memory_site = {                      \
+			.file = __FILE__, .line = __LINE__                  \
+		};                                                          \
+		fn(__VA_ARGS__, &__memory_site);                            \
+	})
+
+#define safe_malloc(size)          MEMORY_SITE_CALL(__safe_malloc, size)
+#define safe_calloc(count, size)   MEMORY_SITE_CALL(__safe_calloc, count, size)
+#define safe_realloc(data, size)   MEMORY_SITE_CALL(__safe_realloc, data, size)
+#define safe_strdup(s)             MEMORY_SITE_CALL(__safe_strdup, s)
+#define safe_realloc_zero(data, old_size, new_size) \
+	MEMORY_SITE_CALL(__safe_realloc_zero, data, old_size, new_size)
+#define safe_aligned_alloc(align, size) \
+	MEMORY_SITE_CALL(__safe_aligned_alloc, align, size)
+
+#endif /* USE_MEMORY_STATS */
+
+/**
+ * @brief A bump allocator that hands out memory from large chunks. There is
+ * no per allocation free; everything is released at once by arena_free(),
+ * or back to an earlier point by arena_rewind(). Allocations are aligned to
+ * ARENA_ALIGN. Like safe_malloc(), arena_alloc() exits on OOM.
+ */
+#define ARENA_ALIGN                   (2 * sizeof(void *))
+#define ARENA_DEFAULT_CHUNK_SIZE      (64 * 1024)
+
+typedef struct arena_chunk_s arena_chunk_t;
+
+typedef struct {
+	arena_chunk_t *head;
+	arena_chunk_t *large;
+	size_t chunk_size;
+} arena_t;
+
+typedef struct {
+	arena_chunk_t *head;
+	arena_chunk_t *large;
+	size_t used;
+} arena_mark_t;
+
+/**
+ * @brief Initialize `arena` to allocate chunks of `chunk_size` bytes (0 for
+ * ARENA_DEFAULT_CHUNK_SIZE). No memory is allocated till the first
+ * arena_alloc().
+ */
+void arena_init(arena_t *arena, size_t chunk_size);
+void *arena_alloc(arena_t *arena, size_t size);
+char *arena_strdup(arena_t *arena, const char *s);
+void arena_free(arena_t *arena);
+
+/**
+ * @brief arena_mark() records the current top of `arena`; arena_rewind()
+ * releases everything allocated after that mark. Marks nest in LIFO order
+ * and a mark is invalidated by rewinding to an older one.
+ *
+ * Example:
+ * 	arena_mark_t m = arena_mark(&arena);
+ * 	split_string_arena(&arena, line, " ", &tokens);
+ * 	...
+ * 	arena_rewind(&arena, m);
+ */
+arena_mark_t arena_mark(arena_t *arena);
+void arena_rewind(arena_t *arena, arena_mark_t mark);
+
+/**
+ * @brief Release all allocations but keep one chunk around so that an arena
+ * that is reset after every request does not go back to malloc each time.
+ */
+void arena_reset(arena_t *arena);
+
 #ifdef __cplusplus
 }
 #endif
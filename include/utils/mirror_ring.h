@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _UTILS_MIRROR_RING_H_
+#define _UTILS_MIRROR_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A byte ring buffer whose storage (a memfd) is mapped twice, back to back,
+ * so that buffer[i] and buffer[i + size] are the same byte. Whatever the
+ * read or write offset, the filled and the free regions are contiguous in
+ * memory: parsers can work on the ring in place and read(2)/write(2) can
+ * move everything in a single call, with no split at the wrap point.
+ *
+ * The size is rounded up to the page size. Like circbuf_t, a ring must
+ * not be pushed to and popped from by different threads without a lock.
+ */
+typedef struct {
+	uint8_t *buffer;
+	size_t size;
+	size_t tail;	/* read offset, in [0, size) */
+	size_t used;
+} mirror_ring_t;
+
+/**
+ * @brief Map a ring of at least `size` bytes.
+ *
+ * @return -1 on errors
+ * @return  0 on success
+ */
+int mirror_ring_init(mirror_ring_t *ring, size_t size);
+
+/**
+ * @brief Unmap the ring set up by mirror_ring_init().
+ */
+void mirror_ring_destroy(mirror_ring_t *ring);
+
+/**
+ * @brief Append `len` bytes from `data` to the ring. Either all of them or
+ * none are pushed.
+ *
+ * @return -1 when fewer than `len` bytes are free
+ * @return  0 on success
+ */
+int mirror_ring_push(mirror_ring_t *ring, const void *data, size_t len);
+
+/**
+ * @brief Remove the oldest `len` bytes from the ring into `data`, which can
+ * be NULL to drop them. mirror_ring_peek() copies them out without
+ * removing them.
+ *
+ * @return -1 when fewer than `len` bytes are in the ring
+ * @return  0 on success
+ */
+int mirror_ring_pop(mirror_ring_t *ring, void *data, size_t len);
+int mirror_ring_peek(mirror_ring_t *ring, void *data, size_t len);
+
+/**
+ * @brief Zero-copy access. mirror_ring_write_reserve() points `ptr` at the
+ * free region and returns its length; the caller fills some of it and
+ * publishes that with mirror_ring_write_commit().
+ * mirror_ring_read_reserve()/mirror_ring_read_commit() do the same for the
+ * filled region; committing a read releases the bytes.
+ *
+ * Usage:
+ *   n = mirror_ring_write_reserve(&rx, &p);
+ *   if (n > 0 && (len = read(fd, p, n)) > 0)
+ *       mirror_ring_write_commit(&rx, len);
+ *
+ * @return RESERVE: number of contiguous bytes at `ptr`
+ * @return COMMIT: 0 on success, -1 when `len` is more than is free/filled
+ */
+size_t mirror_ring_write_reserve(mirror_ring_t *ring, void **ptr);
+int mirror_ring_write_commit(mirror_ring_t *ring, size_t len);
+size_t mirror_ring_read_reserve(mirror_ring_t *ring, void **ptr);
+int mirror_ring_read_commit(mirror_ring_t *ring, size_t len);
+
+/**
+ * @brief Number of bytes in (used) and free in (free_space) the ring.
+ */
+size_t mirror_ring_used(mirror_ring_t *ring);
+size_t mirror_ring_free_space(mirror_ring_t *ring);
+
+/**
+ * @brief Empty the ring. Does not clean the freed bytes.
+ */
+void mirror_ring_flush(mirror_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTILS_MIRROR_RING_H_ */
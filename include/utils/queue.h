@@ -26,6 +26,27 @@ int queue_dequeue(queue_t *queue, queue_node_t **node);
 int queue_peek_last(queue_t *queue, queue_node_t **node);
 int queue_peek_first(queue_t *queue, queue_node_t **node);
 
+/**
+ * Intrusive multi producer/single consumer queue after Dmitry Vyukov's
+ * non-intrusive MPSC node queue. It uses the same embedded queue_node_t
+ * (only its next link). Producers on any number of threads enqueue with a
+ * single atomic exchange and never wait on each other or on the consumer.
+ * Only one thread at a time may dequeue.
+ *
+ * A producer links its node a moment after it swaps it in. A dequeue that
+ * lands in that window returns -1 even though the queue isn't empty; the
+ * node shows up as soon as the producer's enqueue returns.
+ */
+typedef struct {
+	queue_node_t *head;	/* producers: last node in */
+	queue_node_t *tail;	/* consumer: next node out */
+	queue_node_t stub;
+} queue_mpsc_t;
+
+void queue_mpsc_init(queue_mpsc_t *queue);
+void queue_mpsc_enqueue(queue_mpsc_t *queue, queue_node_t *node);
+int queue_mpsc_dequeue(queue_mpsc_t *queue, queue_node_t **node);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _UTILS_SHARD_MAP_H_
+#define _UTILS_SHARD_MAP_H_
+
+#include <stddef.h>
+#include <utils/hashmap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A thread safe hash map made of nr_shards independent hash_map_t's, each
+ * behind its own rwlock. The shard for a key is picked from the high bits of
+ * its hash so threads working on different keys rarely meet on a lock, and
+ * readers of the same shard don't block each other.
+ */
+
+typedef struct shard_map_shard_s shard_map_shard_t;
+
+typedef struct {
+	shard_map_shard_t *shards;
+	size_t nr_shards;
+	unsigned int shift;
+} shard_map_t;
+
+/**
+ * @brief Initialize `smap` with `nr_shards` shards (rounded up to a power of
+ * 2). When `nr_shards` is 0, 4 shards per online CPU are used. Each shard is
+ * a hash_map_t set up from `config` (can be NULL); with RANDOM_SEED, all
+ * shards share one seed.
+ *
+ * @return -1 on errors
+ * @return  0 on success
+ */
+int shard_map_init(shard_map_t *smap, size_t nr_shards,
+		   const hash_map_config_t *config);
+
+/**
+ * @brief Free all shards; `cb` (can be NULL) is called for each item. Must
+ * not race with any other shard_map_* call on `smap`.
+ */
+void shard_map_free(shard_map_t *smap, hash_map_callback_t cb);
+
+/**
+ * @brief Insert (or update) `key` with `val`.
+ *
+ * @return hash of `key`.
+ */
+hash_t shard_map_insert(shard_map_t *smap, const void *key, void *val);
+
+/**
+ * @brief Insert `key` with `val` only if `key` is not already in the map.
+ * The check and the insert are done under the same lock.
+ *
+ * @return -1 if key exists
+ * @return  0 on success
+ */
+int shard_map_add(shard_map_t *smap, const void *key, void *val);
+
+/**
+ * @brief Lookup/remove `key`. The map does not own the values; if another
+ * thread can delete `key` and free its value, the caller must hold off
+ * that free till it is done with the value returned by shard_map_get().
+ *
+ * @return value held for key or NULL when it was not found.
+ */
+void *shard_map_get(shard_map_t *smap, const void *key);
+void *shard_map_delete(shard_map_t *smap, const void *key);
+
+/**
+ * @brief Number of items across all shards. Shards are locked one after the
+ * other so the result can be stale when there are concurrent writers.
+ */
+size_t shard_map_count(shard_map_t *smap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTILS_SHARD_MAP_H_ */
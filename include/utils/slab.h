@@ -17,15 +17,29 @@
 extern "C" {
 #endif
 
+#define SLAB_CACHE_LINE_SIZE          64
+
+/**
+ * Units are laid out back to back in `data`, each `size` bytes long. The
+ * per unit bookkeeping (lease state, canary and free list link) lives in a
+ * separate array at the start of the blob so that it never shares a cache
+ * line with unit data. The records are 8 bytes each (`meta_size`), padded
+ * to a full cache line when the units are cache line aligned.
+ */
 typedef struct {
 	uint8_t *blob;
+	uint8_t *data;
 	size_t size;
+	size_t meta_size;
 	size_t count;
+	size_t nr_free;
+	uint32_t free_head;
 } slab_t;
 
 /**
  * @brief Initializes a resource pool of slabs (out of `blob`) that are
- * at-least `slab_size` bytes long.
+ * at-least `slab_size` bytes long. Large pools can get their blob from
+ * huge_page_alloc() to cut down on TLB misses and remote NUMA accesses.
  *
  * @return -1 on errors
  * @return number of slabs issuable from `blob` on success
@@ -33,10 +47,24 @@ typedef struct {
 int slab_init(slab_t *slab, size_t slab_size,
 	      uint8_t *blob, size_t blob_size);
 
+/**
+ * @brief Same as slab_init() but each slab starts at an `align` (a power of
+ * 2) byte boundary and is padded to a multiple of it. With `align` set to
+ * SLAB_CACHE_LINE_SIZE (or more), threads working on neighbouring slabs
+ * never share a cache line, neither in the data nor in the per slab
+ * records; this costs an extra cache line of `blob` per slab.
+ *
+ * @return -1 on errors
+ * @return number of slabs issuable from `blob` on success
+ */
+int slab_init_aligned(slab_t *slab, size_t slab_size, size_t align,
+		      uint8_t *blob, size_t blob_size);
+
 /**
  * @brief Allocates a slab of memory from the resource pool held at
- * slab_t. The allocated block is at least `size` bytes large is
- * guaranteed to be aligned to a power the nearest power of 2.
+ * slab_t. The allocated block is at least `size` bytes large and is
+ * aligned to sizeof(void *) or the `align` given to slab_init_aligned().
+ * Free slabs are kept in a list so this takes constant time.
  *
  * @return -1 on errors
  * @return  0 on success
@@ -46,13 +74,29 @@ int slab_alloc(slab_t *slab, void **block);
 /**
  * @brief Releases a slab that was previously allocated by a call
  * to slab_alloc(). This method can fail if the pointer passed did
- * not belong to the slab pool of slab_t.
+ * not belong to the slab pool of slab_t or was already released.
  *
  * @return -1 on errors
  * @return  0 on success
  */
 int slab_free(slab_t *slab, void *block);
 
+/** --- Internal methods. DON'T USE ----------------------------------------- */
+
+/**
+ * slab_cache keeps freed blocks in its magazines while the slab still
+ * counts them as leased. __slab_park() marks a leased block as parked and
+ * __slab_unpark() marks it leased again; both change the mark atomically
+ * and fail with -1 if `block` isn't a unit in the expected state, which is
+ * how a double free through the cache is caught. Both write the unit's
+ * record in the side array, which other threads' records share a cache
+ * line with unless the slab is cache line aligned, so only debug (!NDEBUG)
+ * builds of slab_cache use them.
+ */
+int __slab_park(slab_t *slab, void *block);
+int __slab_unpark(slab_t *slab, void *block);
+/* -------------------------------------------------------------------------- */
+
 #ifdef __cplusplus
 }
 #endif
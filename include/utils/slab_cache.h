@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _UTILS_SLAB_CACHE_H_
+#define _UTILS_SLAB_CACHE_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include <utils/slab.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A thread safe front end to a slab_t, after Bonwick's magazines. Each
+ * thread holds two magazines (small stacks of free blocks) of its own and
+ * serves slab_cache_alloc()/slab_cache_free() from them without any lock.
+ * Only when both are empty (alloc) or full (free) does the thread go to
+ * the depot, a lock protected store of full and empty magazines, and trade
+ * a whole magazine at once. The depot falls back to the slab when it has
+ * no full magazines to give.
+ *
+ * Release (NDEBUG) builds do no atomic op on the fast path. Debug builds
+ * also catch double frees by marking each cached block in the slab's side
+ * array, which costs an atomic op per call.
+ *
+ * Free blocks parked in other threads' magazines are not visible to the
+ * allocating thread, so slab_cache_alloc() can fail a little before the
+ * slab is truly exhausted; size the slab with some headroom.
+ */
+
+#define SLAB_CACHE_MAGAZINE_SIZE      16
+
+typedef struct slab_magazine_s slab_magazine_t;
+typedef struct slab_cache_cpu_s slab_cache_cpu_t;
+
+typedef struct {
+	slab_t *slab;
+	size_t magazine_size;
+	pthread_key_t key;
+	pthread_mutex_t lock;
+
+	/* protected by lock */
+	slab_magazine_t *full;
+	slab_magazine_t *empty;
+	slab_cache_cpu_t *threads;
+} slab_cache_t;
+
+/**
+ * @brief Set up `cache` in front of `slab`. Once done, `slab` must only be
+ * used through `cache`. `magazine_size` is the number of blocks a magazine
+ * holds (0 for SLAB_CACHE_MAGAZINE_SIZE); a thread can hold up to twice as
+ * many free blocks.
+ *
+ * @return -1 on errors
+ * @return  0 on success
+ */
+int slab_cache_init(slab_cache_t *cache, slab_t *slab, size_t magazine_size);
+
+/**
+ * @brief Thread safe slab_alloc()/slab_free(). Blocks can be freed by a
+ * thread other than the one that allocated them.
+ *
+ * @return -1 on errors (alloc: slab exhausted; free: not a block of slab
+ *         or, in debug builds, a double free)
+ * @return  0 on success
+ */
+int slab_cache_alloc(slab_cache_t *cache, void **block);
+int slab_cache_free(slab_cache_t *cache, void *block);
+
+/**
+ * @brief Return the free blocks held by the calling thread's magazines to
+ * the depot. Called automatically when a thread exits.
+ */
+void slab_cache_flush(slab_cache_t *cache);
+
+/**
+ * @brief Return all cached blocks to the slab and release the magazines.
+ * No other thread may use `cache` during or after this call.
+ */
+void slab_cache_destroy(slab_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTILS_SLAB_CACHE_H_ */
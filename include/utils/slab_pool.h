@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _UTILS_SLAB_POOL_H_
+#define _UTILS_SLAB_POOL_H_
+
+#include <stddef.h>
+
+#include <utils/slab.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A general purpose allocator made of one slab_t per size class. Sizes up
+ * to 64 bytes come in steps of 16; past that each power of 2 is split into
+ * 4 classes 1.25x, 1.5x, 1.75x and 2x of the previous power of 2 (80, 96,
+ * 112, 128, 160, ...) up to SLAB_POOL_MAX_SIZE. A class grows by adding
+ * backing blobs on demand. Larger requests go to safe_aligned_alloc().
+ *
+ * The slab_pool_* alloc methods mirror their safe_* counterparts: they exit
+ * on OOM and return memory aligned to 16 bytes. Each block carries a header
+ * so slab_pool_free() needs no size; to keep the alignment, that is 16 bytes
+ * per block (the 16 byte class pays 100%). A pool is not thread safe.
+ */
+
+#define SLAB_POOL_MAX_SIZE            (64 * 1024)
+#define SLAB_POOL_NR_CLASSES          44
+#define SLAB_POOL_BLOB_SIZE           (64 * 1024)
+
+typedef struct slab_pool_chunk_s slab_pool_chunk_t;
+
+typedef struct {
+	slab_pool_chunk_t *chunks;
+	slab_pool_chunk_t *partial; /* chunks with free units */
+} slab_pool_class_t;
+
+typedef struct {
+	slab_pool_class_t classes[SLAB_POOL_NR_CLASSES];
+} slab_pool_t;
+
+/**
+ * @brief Initialize an empty `pool`. No memory is allocated till the first
+ * slab_pool_malloc().
+ */
+void slab_pool_init(slab_pool_t *pool);
+
+/**
+ * @brief Release all backing memory of `pool`, including blocks that were
+ * not freed. Large blocks that were not freed are leaked.
+ */
+void slab_pool_destroy(slab_pool_t *pool);
+
+void *slab_pool_malloc(slab_pool_t *pool, size_t size);
+void *slab_pool_calloc(slab_pool_t *pool, size_t count, size_t size);
+void *slab_pool_realloc(slab_pool_t *pool, void *data, size_t size);
+char *slab_pool_strdup(slab_pool_t *pool, const char *s);
+
+/**
+ * @brief Release `data` returned by a slab_pool_* alloc method on `pool`.
+ * `data` can be NULL.
+ */
+void slab_pool_free(slab_pool_t *pool, void *data);
+
+/**
+ * @brief Number of usable bytes in `data`; this is the class size for
+ * small blocks and can be more than was asked for.
+ */
+size_t slab_pool_usable_size(void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTILS_SLAB_POOL_H_ */
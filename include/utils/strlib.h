@@ -10,6 +10,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <utils/memory.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -85,6 +87,14 @@ int string_printf(string_t *s, const char *mode, const char *fmt, ...);
 int string_copy(string_t *s, const char *mode, const char *str, size_t len);
 
 void string_create(string_t *s, const char *buf, size_t len);
+
+/**
+ * Description:
+ * 	Same as string_create() but the buffer comes from `arena`. Like a
+ * 	STRING_DEF() string, it cannot be resized and string_destroy() does
+ * 	not free the buffer; it is released along with the arena.
+ */
+void string_create_arena(arena_t *arena, string_t *s, const char *buf, size_t len);
 void string_clone(string_t *dest, const string_t *src);
 void string_destroy(string_t *s);
 int string_resize(string_t *s, size_t new_len);
@@ -11,6 +11,8 @@
 #include <string.h>
 #include <stdbool.h>
 
+#include <utils/memory.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -108,6 +110,12 @@ void remove_all(char *str, char c);
  */
 int split_string(char *buf, char *sep, char ***tokens);
 
+/**
+ * @brief Same as split_string() but `tokens` and the strings it points to
+ * are allocated from `arena` and released along with it.
+ */
+int split_string_arena(arena_t *arena, char *buf, char *sep, char ***tokens);
+
 /**
  * @brief Return the number of times c occurs in null terminated string s.
  */
@@ -138,6 +146,15 @@ uint32_t hash32_fnv(const char *str, int len);
 uint64_t poly_hash(const char *str, int len);
 #define hash32 hash32_djb2
 #define hash64 poly_hash
+
+/**
+ * @brief Compute a 64 bit hash of `len` bytes at `data` (NUL bytes are not
+ * special). This is wyhash; it consumes 8 bytes at a time and is a lot
+ * faster and better distributed than the byte-at-a-time hashes above. With
+ * a secret (random) seed, the hash values can't be predicted from the input
+ * which makes it suitable for hashing untrusted data.
+ */
+uint64_t hash64_wy(const void *data, size_t len, uint64_t seed);
 /**
  * @brief A strsep() clone. See `man 3 strsep` for more details. str_sep() is
  * cloned here because strsep() is not guaranteed to be available everywhere.
@@ -52,9 +52,9 @@ typedef struct {
 typedef struct {
 	worker_t *workers;
 	int num_workers;
-	queue_t backlog;
+	queue_mpsc_t backlog;
 	int backlog_count;
-	pthread_mutex_t backlog_lock;
+	pthread_mutex_t backlog_lock;	/* one worker at a time dequeues */
 } workqueue_t;
 
 /**
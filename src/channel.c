@@ -424,9 +424,15 @@ struct channel_ops g_channel_ops[CHANNEL_TYPE_SENTINEL] = {
 	},
 };
 
-void channel_manager_init(struct channel_manager *ctx)
+/* held in the map for a device while channel_open() is setting it up */
+static struct channel g_channel_opening;
+
+int channel_manager_init(struct channel_manager *ctx)
 {
-	hash_map_init(&ctx->channels);
+	hash_map_config_t config = { .type = HASH_MAP_TYPE_OPEN };
+
+	ctx->open_channels = 0;
+	return shard_map_init(&ctx->channels, 0, &config);
 }
 
 enum channel_type channel_guess_type(const char *desc)
@@ -461,18 +467,26 @@ int channel_open(struct channel_manager *ctx, enum channel_type type, char *devi
 	if (!device)
 		return CHANNEL_ERR_OPEN_FAILED;
 
-	if (hash_map_get(&ctx->channels, device, 0) != NULL)
-		return CHANNEL_ERR_ALREADY_OPEN;
-
 	c = calloc(1, sizeof(struct channel));
 	if (c == NULL)
 		return CHANNEL_ERR_OOM;
+	c->device = strdup(device);
+
+	/*
+	 * Reserve the device before touching it so that a thread losing the
+	 * race doesn't set up (and flush) a device someone else holds.
+	 */
+	if (shard_map_add(&ctx->channels, c->device, &g_channel_opening)) {
+		free(c->device);
+		free(c);
+		return CHANNEL_ERR_ALREADY_OPEN;
+	}
 
 	c->type = type;
 	c->speed = speed;
-	c->device = strdup(device);
 	c->is_server = is_server;
 	if (g_channel_ops[type].setup(&c->data, c)) {
+		shard_map_delete(&ctx->channels, c->device);
 		free(c->device);
 		free(c);
 		return CHANNEL_ERR_OPEN_FAILED;
@@ -481,9 +495,8 @@ int channel_open(struct channel_manager *ctx, enum channel_type type, char *devi
 	if (g_channel_ops[type].flush) {
 		g_channel_ops[type].flush(c->data);
 	}
-	ctx->open_channels++;
-	c->id = ctx->open_channels;
-	hash_map_insert(&ctx->channels, c->device, c);
+	c->id = __atomic_add_fetch(&ctx->open_channels, 1, __ATOMIC_RELAXED);
+	shard_map_insert(&ctx->channels, c->device, c);
 
 	return CHANNEL_ERR_NONE;
 }
@@ -496,8 +509,8 @@ int channel_get(struct channel_manager *ctx, const char *device,
 {
 	struct channel *c;
 
-	c = hash_map_get(&ctx->channels, device, 0);
-	if (c == NULL)
+	c = shard_map_get(&ctx->channels, device);
+	if (c == NULL || c == &g_channel_opening)
 		return CHANNEL_ERR_NOT_OPEN;
 
 	if(id != NULL)
@@ -518,13 +531,17 @@ int channel_close(struct channel_manager *ctx, const char *device)
 {
 	struct channel *c;
 
-	c = hash_map_get(&ctx->channels, device, 0);
+	/* leave a device that is still being opened to its opener */
+	c = shard_map_get(&ctx->channels, device);
+	if (c == NULL || c == &g_channel_opening)
+		return CHANNEL_ERR_NOT_OPEN;
+
+	c = shard_map_delete(&ctx->channels, device);
 	if (c == NULL)
 		return CHANNEL_ERR_NOT_OPEN;
 
 	g_channel_ops[c->type].teardown(c->data);
-	hash_map_delete(&ctx->channels, device, 0);
-	ctx->open_channels--;
+	__atomic_sub_fetch(&ctx->open_channels, 1, __ATOMIC_RELAXED);
 	free(c->device);
 	free(c);
 	return CHANNEL_ERR_NONE;
@@ -535,18 +552,16 @@ void channel_hash_map_callback(const char *key, void *val)
 	struct channel *c = val;
 	ARG_UNUSED(key);
 
+	if (c == &g_channel_opening)
+		return;
+
+	g_channel_ops[c->type].teardown(c->data);
 	free(c->device);
 	free(c);
 }
 
 void channel_manager_teardown(struct channel_manager *ctx)
 {
-	char *device;
-	struct channel *c;
-
-	HASH_MAP_FOREACH(&ctx->channels, &device, &c) {
-		channel_close(ctx, device);
-	}
-
-	hash_map_free(&ctx->channels, channel_hash_map_callback);
+	shard_map_free(&ctx->channels, channel_hash_map_callback);
+	ctx->open_channels = 0;
 }
@@ -6,22 +6,57 @@
 
 #include <string.h>
 
+#include <utils/utils.h>
 #include <utils/circbuf.h>
 
-int __circbuf_pop(circbuf_t *circ_buf, void *elem, int read_only)
+/* see circbuf_t for how the counts run */
+static inline int circbuf_used(circbuf_t *circ_buf)
 {
 	int total;
-	char *tail;
 
-	total = circ_buf->push_count - circ_buf->pop_count;
+	if (__CIRCBUF_IS_POW2(circ_buf->size))
+		return (int)(circ_buf->push_count - circ_buf->pop_count);
+
+	total = (int)circ_buf->push_count - (int)circ_buf->pop_count;
 	if (total < 0)
 		total += (2 * circ_buf->size);
+	return total;
+}
+
+static inline int circbuf_index(circbuf_t *circ_buf, unsigned int count)
+{
+	unsigned int size = circ_buf->size;
+
+	if (__CIRCBUF_IS_POW2(size))
+		return count & (size - 1);
+	return count >= size ? count - size : count;
+}
+
+static inline unsigned int circbuf_advance(circbuf_t *circ_buf,
+					   unsigned int count, int n)
+{
+	unsigned int size = circ_buf->size;
+
+	count += n;
+	if (!__CIRCBUF_IS_POW2(size) && count >= (2 * size))
+		count -= (2 * size);
+	return count;
+}
 
-	if (total == 0)
+static inline char *circbuf_slot(circbuf_t *circ_buf, int index)
+{
+	return (char *)circ_buf->buffer + (index * circ_buf->element_size);
+}
+
+int __circbuf_pop(circbuf_t *circ_buf, void *elem, int read_only)
+{
+	char *tail;
+
+	if (circbuf_used(circ_buf) == 0)
 		return -1; // Empty
 
-	tail = (char *)circ_buf->buffer + ((circ_buf->pop_count % circ_buf->size)
-			* circ_buf->element_size);
+	tail = circbuf_slot(circ_buf, circbuf_index(circ_buf,
+						    circ_buf->pop_count));
 
 	if (elem)
 		memcpy(elem, tail, circ_buf->element_size);
@@ -30,41 +65,169 @@ int __circbuf_pop(circbuf_t *circ_buf, void *elem, int read_only)
 #ifdef CRICBUF_CLEAN_ON_POP
 		memset(tail, 0, circ_buf->element_size);
 #endif
-		circ_buf->pop_count++;
-		if (circ_buf->pop_count >= (2*circ_buf->size))
-			circ_buf->pop_count = 0;
+		circ_buf->pop_count = circbuf_advance(circ_buf,
+						      circ_buf->pop_count, 1);
 	}
 	return 0;
 }
 
 int __circbuf_push(circbuf_t *circ_buf, void *elem)
 {
-	int total;
 	char *head;
 
-	total = circ_buf->push_count - circ_buf->pop_count;
-	if (total < 0)
-		total += (2 * circ_buf->size);
-
-	if (total >=  circ_buf->size)
+	if (circbuf_used(circ_buf) >= circ_buf->size)
 		return -1; // Full
 
-	head = (char *)circ_buf->buffer + ( (circ_buf->push_count % circ_buf->size)
-			* circ_buf->element_size );
+	head = circbuf_slot(circ_buf, circbuf_index(circ_buf,
+						    circ_buf->push_count));
 	memcpy(head, elem, circ_buf->element_size);
-	circ_buf->push_count++;
-	if (circ_buf->push_count >= (2*circ_buf->size))
-		circ_buf->push_count = 0;
+	circ_buf->push_count = circbuf_advance(circ_buf, circ_buf->push_count, 1);
 	return 0;
 }
 
 int __circbuf_free_space(circbuf_t *circ_buf)
 {
-	int total;
+	return circ_buf->size - circbuf_used(circ_buf);
+}
 
-	total = circ_buf->push_count - circ_buf->pop_count;
-	if (total < 0)
-		total += (2 * circ_buf->size);
+int __circbuf_push_n(circbuf_t *circ_buf, const void *elems, int count)
+{
+	int n, head, first;
+	size_t es = circ_buf->element_size;
+
+	n = MIN(count, circ_buf->size - circbuf_used(circ_buf));
+	if (n <= 0)
+		return 0;
+
+	head = circbuf_index(circ_buf, circ_buf->push_count);
+	first = MIN(n, circ_buf->size - head);
+	memcpy(circbuf_slot(circ_buf, head), elems, first * es);
+	if (n > first)
+		memcpy(circ_buf->buffer, (const char *)elems + first * es,
+		       (n - first) * es);
+	circ_buf->push_count = circbuf_advance(circ_buf, circ_buf->push_count, n);
+	return n;
+}
+
+int __circbuf_pop_n(circbuf_t *circ_buf, void *elems, int count)
+{
+	int n, tail, first;
+	size_t es = circ_buf->element_size;
+
+	n = MIN(count, circbuf_used(circ_buf));
+	if (n <= 0)
+		return 0;
+
+	tail = circbuf_index(circ_buf, circ_buf->pop_count);
+	first = MIN(n, circ_buf->size - tail);
+	if (elems) {
+		memcpy(elems, circbuf_slot(circ_buf, tail), first * es);
+		if (n > first)
+			memcpy((char *)elems + first * es, circ_buf->buffer,
+			       (n - first) * es);
+	}
+#ifdef CRICBUF_CLEAN_ON_POP
+	memset(circbuf_slot(circ_buf, tail), 0, first * es);
+	if (n > first)
+		memset(circ_buf->buffer, 0, (n - first) * es);
+#endif
+	circ_buf->pop_count = circbuf_advance(circ_buf, circ_buf->pop_count, n);
+	return n;
+}
+
+int __circbuf_write_reserve(circbuf_t *circ_buf, void **ptr)
+{
+	int head;
+
+	head = circbuf_index(circ_buf, circ_buf->push_count);
+	*ptr = circbuf_slot(circ_buf, head);
+	return MIN(circ_buf->size - circbuf_used(circ_buf),
+		   circ_buf->size - head);
+}
+
+int __circbuf_write_commit(circbuf_t *circ_buf, int count)
+{
+	if (count < 0 || count > circ_buf->size - circbuf_used(circ_buf))
+		return -1;
+
+	circ_buf->push_count = circbuf_advance(circ_buf, circ_buf->push_count,
+					       count);
+	return 0;
+}
+
+int __circbuf_read_reserve(circbuf_t *circ_buf, void **ptr)
+{
+	int tail;
+
+	tail = circbuf_index(circ_buf, circ_buf->pop_count);
+	*ptr = circbuf_slot(circ_buf, tail);
+	return MIN(circbuf_used(circ_buf), circ_buf->size - tail);
+}
+
+int __circbuf_read_commit(circbuf_t *circ_buf, int count)
+{
+	if (count < 0 || count > circbuf_used(circ_buf))
+		return -1;
+
+	__circbuf_pop_n(circ_buf, NULL, count);
+	return 0;
+}
+
+int __circbuf_spsc_push(circbuf_spsc_t *circ_buf, void *elem)
+{
+	char *head;
+	size_t tail = circ_buf->tail;
+
+	if (tail - circ_buf->cached_head >= (size_t)circ_buf->size) {
+		circ_buf->cached_head = __atomic_load_n(&circ_buf->head,
+							__ATOMIC_ACQUIRE);
+		if (tail - circ_buf->cached_head >= (size_t)circ_buf->size)
+			return -1; // Full
+	}
+
+	head = (char *)circ_buf->buffer + (__circbuf_wrap(tail, circ_buf->size)
+			* circ_buf->element_size);
+	memcpy(head, elem, circ_buf->element_size);
+	__atomic_store_n(&circ_buf->tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int __circbuf_spsc_pop(circbuf_spsc_t *circ_buf, void *elem, int read_only)
+{
+	char *tail;
+	size_t head = circ_buf->head;
+
+	if (head == circ_buf->cached_tail) {
+		circ_buf->cached_tail = __atomic_load_n(&circ_buf->tail,
+							__ATOMIC_ACQUIRE);
+		if (head == circ_buf->cached_tail)
+			return -1; // Empty
+	}
+
+	tail = (char *)circ_buf->buffer + (__circbuf_wrap(head, circ_buf->size)
+			* circ_buf->element_size);
+
+	if (elem)
+		memcpy(elem, tail, circ_buf->element_size);
+
+	if (!read_only) {
+#ifdef CRICBUF_CLEAN_ON_POP
+		memset(tail, 0, circ_buf->element_size);
+#endif
+		__atomic_store_n(&circ_buf->head, head + 1, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+int __circbuf_spsc_free_space(circbuf_spsc_t *circ_buf)
+{
+	size_t head, tail, used = 0;
+
+	/* tail first: then head can only have moved closer to it */
+	tail = __atomic_load_n(&circ_buf->tail, __ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&circ_buf->head, __ATOMIC_ACQUIRE);
+	if (tail > head)
+		used = tail - head;
 
-	return circ_buf->size - total;
+	return circ_buf->size - (int)used;
 }
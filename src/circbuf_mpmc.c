@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdbool.h>
+
+#include <utils/circbuf_mpmc.h>
+
+/**
+ * Slot i is ready for the push at position pos when its sequence is pos and
+ * for the pop at pos when it is pos + 1. The stored value is the sequence
+ * less i (see circbuf_mpmc_t).
+ */
+static inline size_t *slot_seq(circbuf_mpmc_t *circ_buf, size_t i)
+{
+	return (size_t *)((char *)circ_buf->buffer + i * circ_buf->slot_size);
+}
+
+static inline char *slot_data(circbuf_mpmc_t *circ_buf, size_t i)
+{
+	return (char *)slot_seq(circ_buf, i) + circ_buf->data_offset;
+}
+
+int __circbuf_mpmc_push(circbuf_mpmc_t *circ_buf, void *elem)
+{
+	size_t i, seq, pos;
+	intptr_t diff;
+
+	pos = __atomic_load_n(&circ_buf->tail, __ATOMIC_RELAXED);
+	for (;;) {
+		i = __circbuf_wrap(pos, circ_buf->size);
+		seq = __atomic_load_n(slot_seq(circ_buf, i), __ATOMIC_ACQUIRE) + i;
+		diff = (intptr_t)(seq - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&circ_buf->tail, &pos,
+							pos + 1, true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return -1; // Full
+		} else {
+			/* another producer got here first */
+			pos = __atomic_load_n(&circ_buf->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	memcpy(slot_data(circ_buf, i), elem, circ_buf->element_size);
+	__atomic_store_n(slot_seq(circ_buf, i), pos + 1 - i, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int __circbuf_mpmc_pop(circbuf_mpmc_t *circ_buf, void *elem)
+{
+	size_t i, seq, pos;
+	intptr_t diff;
+
+	pos = __atomic_load_n(&circ_buf->head, __ATOMIC_RELAXED);
+	for (;;) {
+		i = __circbuf_wrap(pos, circ_buf->size);
+		seq = __atomic_load_n(slot_seq(circ_buf, i), __ATOMIC_ACQUIRE) + i;
+		diff = (intptr_t)(seq - (pos + 1));
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&circ_buf->head, &pos,
+							pos + 1, true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return -1; // Empty
+		} else {
+			/* another consumer got here first */
+			pos = __atomic_load_n(&circ_buf->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	if (elem)
+		memcpy(elem, slot_data(circ_buf, i), circ_buf->element_size);
+#ifdef CRICBUF_CLEAN_ON_POP
+	memset(slot_data(circ_buf, i), 0, circ_buf->element_size);
+#endif
+	/* ready for the push one lap later */
+	__atomic_store_n(slot_seq(circ_buf, i), pos + circ_buf->size - i,
+			 __ATOMIC_RELEASE);
+	return 0;
+}
+
+int __circbuf_mpmc_free_space(circbuf_mpmc_t *circ_buf)
+{
+	size_t head, tail, used = 0;
+
+	/* tail first: then head can only have moved closer to it */
+	tail = __atomic_load_n(&circ_buf->tail, __ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&circ_buf->head, __ATOMIC_ACQUIRE);
+	if (tail > head)
+		used = tail - head;
+
+	return circ_buf->size - (int)used;
+}
+
+void __circbuf_mpmc_flush(circbuf_mpmc_t *circ_buf)
+{
+	int i;
+
+	for (i = 0; i < circ_buf->size; i++)
+		*slot_seq(circ_buf, i) = 0;
+	circ_buf->head = 0;
+	circ_buf->tail = 0;
+}
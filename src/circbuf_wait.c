@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+
+#include <utils/utils.h>
+#include <utils/circbuf_wait.h>
+
+int __circbuf_wait_init(circbuf_wait_t *w)
+{
+	if (event_init(&w->not_empty, false, false))
+		return -1;
+	if (event_init(&w->not_full, false, false)) {
+		event_cleanup(&w->not_empty);
+		return -1;
+	}
+	w->waiting = 0;
+	return 0;
+}
+
+void __circbuf_wait_cleanup(circbuf_wait_t *w)
+{
+	event_cleanup(&w->not_empty);
+	event_cleanup(&w->not_full);
+}
+
+/*
+ * The fences order our ring update against the load of the other side's
+ * bit, and its bit against its retry: either it sees our update or we see
+ * its bit and set the event.
+ */
+static inline void circbuf_wait_announce(circbuf_wait_t *w, int who)
+{
+	__atomic_fetch_or(&w->waiting, who, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void circbuf_wait_wake(circbuf_wait_t *w, int who, event_t *e)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&w->waiting, __ATOMIC_RELAXED) & who)
+		event_set(e);
+}
+
+static int circbuf_wait_sleep(event_t *e, tick_t start, int timeout_ms)
+{
+	tick_t elapsed;
+
+	if (timeout_ms < 0)
+		return event_wait(e, -1);
+
+	elapsed = millis_since(start);
+	if (elapsed >= (tick_t)timeout_ms)
+		return 0;
+	return event_wait(e, timeout_ms - (int)elapsed);
+}
+
+int __circbuf_wait_push(circbuf_wait_t *w, void *elem, int timeout_ms)
+{
+	int rc;
+	bool waiting = false;
+	tick_t start = 0;
+
+	while ((rc = __circbuf_spsc_push(w->ring, elem)) != 0) {
+		if (timeout_ms == 0)
+			break;
+		if (!waiting) {
+			/* look once more after saying we are about to sleep */
+			start = millis_now();
+			circbuf_wait_announce(w, __CIRCBUF_WAIT_PRODUCER);
+			waiting = true;
+			continue;
+		}
+		if (circbuf_wait_sleep(&w->not_full, start, timeout_ms) <= 0) {
+			/* timed out; it may have changed since the last look */
+			rc = __circbuf_spsc_push(w->ring, elem);
+			break;
+		}
+	}
+	if (waiting)
+		__atomic_fetch_and(&w->waiting, ~__CIRCBUF_WAIT_PRODUCER,
+				   __ATOMIC_RELAXED);
+	if (rc == 0)
+		circbuf_wait_wake(w, __CIRCBUF_WAIT_CONSUMER, &w->not_empty);
+	return rc;
+}
+
+int __circbuf_wait_pop(circbuf_wait_t *w, void *elem, int timeout_ms)
+{
+	int rc;
+	bool waiting = false;
+	tick_t start = 0;
+
+	while ((rc = __circbuf_spsc_pop(w->ring, elem, 0)) != 0) {
+		if (timeout_ms == 0)
+			break;
+		if (!waiting) {
+			start = millis_now();
+			circbuf_wait_announce(w, __CIRCBUF_WAIT_CONSUMER);
+			waiting = true;
+			continue;
+		}
+		if (circbuf_wait_sleep(&w->not_empty, start, timeout_ms) <= 0) {
+			/* timed out; it may have changed since the last look */
+			rc = __circbuf_spsc_pop(w->ring, elem, 0);
+			break;
+		}
+	}
+	if (waiting)
+		__atomic_fetch_and(&w->waiting, ~__CIRCBUF_WAIT_CONSUMER,
+				   __ATOMIC_RELAXED);
+	if (rc == 0)
+		circbuf_wait_wake(w, __CIRCBUF_WAIT_PRODUCER, &w->not_full);
+	return rc;
+}
@@ -42,6 +42,8 @@
  * CRC32 code derived from work by Gary S. Brown.
  */
 
+#include <string.h>
+
 #include <utils/crc32.h>
 
 const uint32_t crc32_tab[] = {
@@ -740,8 +742,67 @@ multitable_crc32c(uint32_t crc32c,
 	return (crc32c_sb8_64_bit(crc32c, buffer, length, to_even_word));
 }
 
+/*
+ * CRC32C instructions of SSE4.2 and ARMv8 compute the same (reflected, no
+ * pre/post inversion) CRC as the tables above, 8 bytes at a time. On x86
+ * the instruction is probed at runtime so that builds need no -msse4.2.
+ */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+
+#include <nmmintrin.h>
+
+#define hw_crc32c_supported()  __builtin_cpu_supports("sse4.2")
+
+__attribute__((target("sse4.2")))
+static uint32_t hw_crc32c(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t c = crc, v;
+
+	while (len >= sizeof(v)) {
+		memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+		p += sizeof(v);
+		len -= sizeof(v);
+	}
+	crc = (uint32_t)c;
+	while (len--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+
+#include <arm_acle.h>
+
+#define hw_crc32c_supported()  1
+
+static uint32_t hw_crc32c(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t v;
+
+	while (len >= sizeof(v)) {
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+		p += sizeof(v);
+		len -= sizeof(v);
+	}
+	while (len--)
+		crc = __crc32cb(crc, *p++);
+	return crc;
+}
+
+#else
+
+#define hw_crc32c_supported()  0
+#define hw_crc32c(crc, p, len) (crc)
+
+#endif
+
 uint32_t compute_crc32(uint32_t seed, const uint8_t *buffer, size_t length)
 {
+	if (hw_crc32c_supported())
+		return hw_crc32c(seed, buffer, length);
+
 	if (length < 4) {
 		return (singletable_crc32c(seed, buffer, length));
 	} else {
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include <sys/fcntl.h>
 
@@ -77,3 +78,22 @@ bool event_is_set(event_t *e)
 
 	return flush_fd(e->rfd);
 }
+
+int event_wait(event_t *e, int timeout_ms)
+{
+	int ret;
+	struct pollfd pfd = { .fd = e->rfd, .events = POLLIN };
+
+	if (!e->initialized)
+		return -1;
+
+	do {
+		ret = poll(&pfd, 1, timeout_ms);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret <= 0)
+		return ret;
+
+	/* another waiter may have cleared it in the meantime */
+	return event_is_set(e) ? 1 : 0;
+}
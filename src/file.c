@@ -120,18 +120,9 @@ int file_read_all(FILE *in, char **dataptr, size_t *sizeptr)
 	return 0;
 }
 
-char *path_join(const char *p1, const char *p2)
+static void path_join_copy(char *path, const char *p1, size_t p1_len,
+			   const char *p2, size_t p2_len)
 {
-	char *path;
-	size_t p1_len, p2_len;
-
-	if (p2 == NULL)
-		return NULL;
-	if (p2[0] == PATH_SEP)
-		return safe_strdup(p2);
-	p1_len = (p1 == NULL) ? 0 : strlen(p1);
-	p2_len = strlen(p2);
-	path = safe_malloc(sizeof(char) * (p1_len + p2_len + 2));
 	if (p1) {
 		memcpy(path, p1, p1_len);
 	}
@@ -143,6 +134,37 @@ char *path_join(const char *p1, const char *p2)
 		memcpy(path + p1_len, p2, p2_len);
 		path[p1_len + p2_len] = '\0';
 	}
+}
+
+char *path_join(const char *p1, const char *p2)
+{
+	char *path;
+	size_t p1_len, p2_len;
+
+	if (p2 == NULL)
+		return NULL;
+	if (p2[0] == PATH_SEP)
+		return safe_strdup(p2);
+	p1_len = (p1 == NULL) ? 0 : strlen(p1);
+	p2_len = strlen(p2);
+	path = safe_malloc(sizeof(char) * (p1_len + p2_len + 2));
+	path_join_copy(path, p1, p1_len, p2, p2_len);
+	return path;
+}
+
+char *path_join_arena(arena_t *arena, const char *p1, const char *p2)
+{
+	char *path;
+	size_t p1_len, p2_len;
+
+	if (p2 == NULL)
+		return NULL;
+	if (p2[0] == PATH_SEP)
+		return arena_strdup(arena, p2);
+	p1_len = (p1 == NULL) ? 0 : strlen(p1);
+	p2_len = strlen(p2);
+	path = arena_alloc(arena, sizeof(char) * (p1_len + p2_len + 2));
+	path_join_copy(path, p1, p1_len, p2, p2_len);
 	return path;
 }
 
@@ -156,10 +178,10 @@ char **fs_path_walk(const char *root_dir)
 	char *root;
 	struct dirent *dir_ent;
 	size_t nr_dirs = 0, dirs_capacity = 32, nr_files = 0, files_capacity = 32;
-	char **files = malloc(sizeof(char *) * files_capacity);
-	char **dirs = malloc(sizeof(char *) * files_capacity);
+	char **files = safe_malloc(sizeof(char *) * files_capacity);
+	char **dirs = safe_malloc(sizeof(char *) * dirs_capacity);
 
-	dirs[nr_dirs++] = strdup(root_dir);
+	dirs[nr_dirs++] = safe_strdup(root_dir);
 	while (nr_dirs > 0) {
 		root = dirs[--nr_dirs];
 		dir = opendir(root);
@@ -172,7 +194,7 @@ char **fs_path_walk(const char *root_dir)
 				files[nr_files++] = path_join(root, dir_ent->d_name);
 				if (nr_files == files_capacity) {
 					files_capacity <<= 1;
-					files = realloc(files, sizeof(char *) * files_capacity);
+					files = safe_realloc(files, sizeof(char *) * files_capacity);
 				}
 			}
 			else if (dir_ent->d_type == DT_DIR) {
@@ -182,14 +204,14 @@ char **fs_path_walk(const char *root_dir)
 				dirs[nr_dirs++] = path_join(root, dir_ent->d_name);
 				if (nr_dirs == dirs_capacity) {
 					dirs_capacity <<= 1;
-					dirs = realloc(dirs, sizeof(char *) * dirs_capacity);
+					dirs = safe_realloc(dirs, sizeof(char *) * dirs_capacity);
 				}
 			}
 		}
 		closedir(dir);
-		free(root);
+		safe_free(root);
 	}
-	free(dirs);
+	safe_free(dirs);
 	files[nr_files] = NULL;
 	return files;
 }
@@ -198,10 +220,10 @@ void fs_path_walk_free(char **files)
 {
 	int i = 0;
 	while (files[i] != NULL) {
-		free(files[i]);
+		safe_free(files[i]);
 		i++;
 	}
-	free(files);
+	safe_free(files);
 }
 
 bool dir_exists(const char *path)
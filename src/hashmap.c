@@ -1,30 +1,168 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
 
 #include <utils/utils.h>
 #include <utils/memory.h>
 #include <utils/strutils.h>
+#include <utils/crc32.h>
+#include <utils/random.h>
 #include <utils/hashmap.h>
 
-#define hash_fn hash32_djb2
+#define hash_str hash32_djb2
 
 #define HASH_MAP_BASE_SIZE            32
 #define HASH_MAP_DENSITY_FACTOR       0.8
+#define HASH_MAP_REHASH_STEP          16
 #define MAP_DENSITY(map) \
 		((double)(map)->count / (double)(map)->capacity)
+#define MAP_NEEDS_GROW(map) \
+		(MAP_DENSITY(map) > (map)->load_factor)
 #define GET_POOL_POS(map, hash) \
 		(hash & (map->capacity - 1))
 
 #if 0
-#define hash_check_key(m, i, k) \
-	if (strcmp(i->key, k) != 0) { \
-		printf("Error: Hash collusion in %s for %s/%s\n", m, k, i->key); \
+#define hash_check_key(map, m, i, k) \
+	if (k && !hash_key_match(map, i->key, k)) { \
+		printf("Error: Hash collusion in %s for %p/%p\n", m, k, i->key); \
 	}
 #else
-#define hash_check_key(m, i, k)
+#define hash_check_key(map, m, i, k)
 #endif
 
+/* BINARY and U64 keys are copied into the map's own storage */
+#define MAP_KEY_INLINE(map) \
+		((map)->key_len != 0 && !((map)->flags & HASH_MAP_FLAG_BORROW_KEYS))
+
+/* HASH_MAP_FLAG_ARENA: items and keys are released with the arena */
+#define MAP_USES_ARENA(map)           ((map)->flags & HASH_MAP_FLAG_ARENA)
+
+struct hash_map_ops {
+	void (*init)(hash_map_t *map, size_t capacity);
+	void (*free)(hash_map_t *map, hash_map_callback_t cb);
+	hash_t (*insert)(hash_map_t *map, const void *key, hash_t hash, void *val);
+	void *(*get)(hash_map_t *map, const void *key, hash_t hash);
+	void *(*delete)(hash_map_t *map, const void *key, hash_t hash);
+	int (*it_next)(hash_map_iterator_t *it, char **key, void **val);
+	void (*prefetch)(hash_map_t *map, hash_t hash, int stage);
+	void (*compact)(hash_map_t *map);
+};
+
+/* smallest table that holds `count` items within the load factor */
+static size_t hash_map_fit_capacity(hash_map_t *map, size_t count)
+{
+	size_t capacity = HASH_MAP_BASE_SIZE;
+
+	while ((double)count > (double)capacity * map->load_factor)
+		capacity <<= 1;
+	return capacity;
+}
+
+static inline bool hash_map_should_shrink(hash_map_t *map)
+{
+	return map->shrink_factor > 0 && map->capacity > HASH_MAP_BASE_SIZE &&
+	       (double)map->count < (double)map->capacity * map->shrink_factor;
+}
+
+/*
+ * Shrink to a table that is about half full at the load factor, so that a
+ * shrunk map is neither close to growing again nor to the next shrink.
+ */
+static inline size_t hash_map_shrink_capacity(hash_map_t *map)
+{
+	return hash_map_fit_capacity(map, 2 * map->count);
+}
+
+/* --- keys --- */
+
+static inline uint64_t hash_key_u64(const void *key)
+{
+	uint64_t k;
+
+	memcpy(&k, key, sizeof(k));
+	return k;
+}
+
+/* MurmurHash3's fmix64(); every input bit affects every output bit */
+static inline hash_t hash_u64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return (hash_t)k;
+}
+
+/* FNV-1a; unlike hash_str, it does not stop at a NUL byte */
+static inline hash_t hash_bytes(const void *key, size_t len)
+{
+	const uint8_t *p = key;
+	uint32_t hash = 0x811c9dc5;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+hash_t hash_map_hash_wy(const void *key, size_t len, uint64_t seed)
+{
+	uint64_t hash = hash64_wy(key, len, seed);
+
+	return (hash_t)(hash ^ (hash >> 32));
+}
+
+hash_t hash_map_hash_crc32c(const void *key, size_t len, uint64_t seed)
+{
+	return compute_crc32((uint32_t)(seed ^ (seed >> 32)), key, len);
+}
+
+static hash_t hash_key(hash_map_t *map, const void *key)
+{
+	if (map->hash_fn != NULL)
+		return map->hash_fn(key, map->key_len ? map->key_len :
+				    strlen(key), map->seed);
+
+	switch (map->key_type) {
+	case HASH_MAP_KEY_U64:
+		return hash_u64(hash_key_u64(key));
+	case HASH_MAP_KEY_BINARY:
+		return hash_bytes(key, map->key_len);
+	default:
+		return hash_str(key, -1);
+	}
+}
+
+/* A NULL key matches on hash alone; see hash_map_get() */
+static inline bool hash_key_match(hash_map_t *map, const char *item_key,
+				  const void *key)
+{
+	if (key == NULL)
+		return true;
+
+	switch (map->key_type) {
+	case HASH_MAP_KEY_U64:
+		return hash_key_u64(item_key) == hash_key_u64(key);
+	case HASH_MAP_KEY_BINARY:
+		return memcmp(item_key, key, map->key_len) == 0;
+	default:
+		return strcmp(item_key, key) == 0;
+	}
+}
+
+/* --- HASH_MAP_TYPE_CHAINED --- */
+
+#define MAP_IS_MIGRATING(map)         ((map)->old_pool != NULL)
+
 static size_t hash_map_count(hash_map_t *map)
 {
 	size_t i, count = 0;
@@ -37,6 +175,13 @@ static size_t hash_map_count(hash_map_t *map)
 			item = item->next;
 		}
 	}
+	for (i = map->migrate_pos; i < map->old_capacity; i++) {
+		item = map->old_pool[i];
+		while (item) {
+			count += 1;
+			item = item->next;
+		}
+	}
 	return count;
 }
 
@@ -87,55 +232,210 @@ static void hash_map_rehash(hash_map_t *map)
 	hash_map_lint(map);
 }
 
-void hash_map_init(hash_map_t *map)
+/**
+ * Incremental rehash: the current pool is parked in map->old_pool and a new
+ * pool of twice the size takes its place. Buckets of the old pool in the
+ * range [migrate_pos .. old_capacity) are yet to be moved, so a key lives
+ * in the old pool if its old bucket falls in that range and in the new pool
+ * otherwise. Every insert moves a bounded number of old buckets.
+ */
+static void hash_map_migrate(hash_map_t *map, size_t nr_buckets)
 {
-	size_t size;
+	size_t target, end;
+	hash_map_item_t *item, *next;
 
-	size = round_up_pow2(HASH_MAP_BASE_SIZE);
-	map->pool = safe_calloc(size, sizeof(hash_map_item_t *));
-	map->capacity = size;
-	map->count = 0;
+	end = MIN(map->migrate_pos + nr_buckets, map->old_capacity);
+	while (map->migrate_pos < end) {
+		item = map->old_pool[map->migrate_pos];
+		while (item != NULL) {
+			next = item->next;
+			target = GET_POOL_POS(map, item->hash);
+			item->next = map->pool[target];
+			map->pool[target] = item;
+			item = next;
+		}
+		map->old_pool[map->migrate_pos] = NULL;
+		map->migrate_pos += 1;
+	}
+	if (map->migrate_pos == map->old_capacity) {
+		safe_free(map->old_pool);
+		map->old_pool = NULL;
+		map->old_capacity = 0;
+		map->migrate_pos = 0;
+	}
 }
 
-void hash_map_free(hash_map_t *map, hash_map_callback_t callback)
+static void hash_map_rehash_start(hash_map_t *map)
+{
+	/* can't park two pools, finish the current move first */
+	if (MAP_IS_MIGRATING(map))
+		hash_map_migrate(map, map->old_capacity);
+
+	map->old_pool = map->pool;
+	map->old_capacity = map->capacity;
+	map->migrate_pos = 0;
+	map->capacity <<= 1;
+	map->pool = safe_calloc(map->capacity, sizeof(hash_map_item_t *));
+}
+
+static hash_map_item_t **chained_bucket(hash_map_t *map, hash_t hash)
+{
+	size_t pos;
+
+	if (MAP_IS_MIGRATING(map)) {
+		pos = hash & (map->old_capacity - 1);
+		if (pos >= map->migrate_pos)
+			return map->old_pool + pos;
+	}
+	return map->pool + GET_POOL_POS(map, hash);
+}
+
+static void chained_free_items(hash_map_t *map, hash_map_item_t **pool,
+			       size_t capacity, hash_map_callback_t callback)
 {
 	size_t pos = 0;
 	hash_map_item_t *item, *next;
 
-	while (pos < map->capacity) {
-		item = map->pool[pos];
+	if (MAP_USES_ARENA(map) && callback == NULL)
+		return;
+
+	while (pos < capacity) {
+		item = pool[pos];
 		while (item != NULL) {
-			callback(item->key, item->val);
+			if (callback)
+				callback(item->key, item->val);
 			next = item->next;
-			safe_free(item->key);
-			safe_free(item);
+			if (!MAP_USES_ARENA(map))
+				safe_free(item);
 			item = next;
 		}
 		pos += 1;
 	}
+}
+
+/**
+ * Unless borrowed, the key is copied into the same allocation as the item
+ * right after it; so deleting an item is a single free.
+ */
+static hash_map_item_t *chained_item_new(hash_map_t *map, const void *key,
+					 hash_t hash, void *val)
+{
+	size_t key_size = 0;
+	hash_map_item_t *item;
+
+	if (!(map->flags & HASH_MAP_FLAG_BORROW_KEYS))
+		key_size = map->key_len ? map->key_len : strlen(key) + 1;
+
+	if (MAP_USES_ARENA(map))
+		item = arena_alloc(&map->arena, sizeof(hash_map_item_t) + key_size);
+	else
+		item = safe_malloc(sizeof(hash_map_item_t) + key_size);
+	if (key_size) {
+		item->key = (char *)(item + 1);
+		memcpy(item->key, key, key_size);
+	} else {
+		item->key = (char *)key;
+	}
+	item->hash = hash;
+	item->val = val;
+	item->next = NULL;
+	return item;
+}
+
+static void chained_init(hash_map_t *map, size_t capacity)
+{
+	map->pool = safe_calloc(capacity, sizeof(hash_map_item_t *));
+	map->capacity = capacity;
+}
+
+static void chained_free(hash_map_t *map, hash_map_callback_t callback)
+{
+	chained_free_items(map, map->pool, map->capacity, callback);
 	safe_free(map->pool);
 	map->pool = NULL;
-	map->capacity = 0;
-	map->capacity = 0;
+	if (MAP_IS_MIGRATING(map)) {
+		chained_free_items(map, map->old_pool, map->old_capacity,
+				   callback);
+		safe_free(map->old_pool);
+		map->old_pool = NULL;
+		map->old_capacity = 0;
+		map->migrate_pos = 0;
+	}
+	arena_free(&map->arena);
 }
 
-hash_t hash_map_insert(hash_map_t *map, const char *key, void *val)
+/* relink all items into a new pool; also ends a migration in progress */
+static void chained_resize(hash_map_t *map, size_t capacity)
+{
+	size_t pos, old_capacity;
+	hash_map_item_t **old_pool, **bucket, *item, *next;
+
+	if (MAP_IS_MIGRATING(map))
+		hash_map_migrate(map, map->old_capacity);
+	old_pool = map->pool;
+	old_capacity = map->capacity;
+	chained_init(map, capacity);
+	for (pos = 0; pos < old_capacity; pos++) {
+		for (item = old_pool[pos]; item != NULL; item = next) {
+			next = item->next;
+			bucket = map->pool + GET_POOL_POS(map, item->hash);
+			item->next = *bucket;
+			*bucket = item;
+		}
+	}
+	safe_free(old_pool);
+}
+
+/* copy live items into a new arena, leaving the space of deleted ones */
+static void chained_rebuild_arena(hash_map_t *map)
 {
-	hash_t hash;
 	size_t pos;
-	hash_map_item_t *prev, *item;
+	arena_t old = map->arena;
+	hash_map_item_t **link, *item;
+
+	arena_init(&map->arena, old.chunk_size);
+	for (pos = 0; pos < map->capacity; pos++) {
+		link = map->pool + pos;
+		for (item = *link; item != NULL; item = item->next) {
+			*link = chained_item_new(map, item->key, item->hash,
+						 item->val);
+			link = &(*link)->next;
+		}
+	}
+	arena_free(&old);
+}
+
+static void chained_compact(hash_map_t *map)
+{
+	size_t capacity = hash_map_fit_capacity(map, map->count);
+
+	if (capacity != map->capacity || MAP_IS_MIGRATING(map))
+		chained_resize(map, capacity);
+	if (MAP_USES_ARENA(map))
+		chained_rebuild_arena(map);
+}
 
-	if (MAP_DENSITY(map) > HASH_MAP_DENSITY_FACTOR)
+static hash_t chained_insert(hash_map_t *map, const void *key,
+			     hash_t hash, void *val)
+{
+	hash_map_item_t **bucket, *prev, *item;
+
+	if (map->flags & HASH_MAP_FLAG_INCREMENTAL_REHASH) {
+		if (MAP_IS_MIGRATING(map))
+			hash_map_migrate(map, HASH_MAP_REHASH_STEP);
+		if (MAP_NEEDS_GROW(map))
+			hash_map_rehash_start(map);
+	} else if (MAP_NEEDS_GROW(map)) {
 		hash_map_rehash(map);
+	}
 
-	hash = hash_fn(key, -1);
-	pos = GET_POOL_POS(map, hash);
-	item = prev = map->pool[pos];
+	bucket = chained_bucket(map, hash);
+	item = prev = *bucket;
 	while (item != NULL) {
 		if (item->hash == hash) {
 			/* key already exists update it */
-			hash_check_key("insert", item, key);
-			if (strcmp(item->key, key) == 0) {
+			hash_check_key(map, "insert", item, key);
+			if (hash_key_match(map, item->key, key)) {
 				item->val = val;
 				return item->hash;
 			}
@@ -145,32 +445,24 @@ hash_t hash_map_insert(hash_map_t *map, const char *key, void *val)
 	}
 
 	/* insert new key */
-	item = safe_malloc(sizeof(hash_map_item_t));
-	item->hash = hash;
-	item->key = safe_strdup(key);
-	item->val = val;
-	item->next = NULL;
+	item = chained_item_new(map, key, hash, val);
 	if (prev != NULL)
 		prev->next = item;
 	else
-		map->pool[pos] = item;
+		*bucket = item;
 	map->count += 1;
 	return item->hash;
 }
 
-void *hash_map_get(hash_map_t *map, const char *key, hash_t key_hash)
+static void *chained_get(hash_map_t *map, const void *key, hash_t hash)
 {
-	hash_t hash;
-	size_t pos;
 	hash_map_item_t *item;
 
-	hash = key ? hash_fn(key, -1) : key_hash;
-	pos = GET_POOL_POS(map, hash);
-	item = map->pool[pos];
+	item = *chained_bucket(map, hash);
 	while (item != NULL) {
 		if (item->hash == hash) {
-			hash_check_key("get", item, key);
-			if (strcmp(item->key, key) == 0) {
+			hash_check_key(map, "get", item, key);
+			if (hash_key_match(map, item->key, key)) {
 				return item->val;
 			}
 		}
@@ -179,20 +471,28 @@ void *hash_map_get(hash_map_t *map, const char *key, hash_t key_hash)
 	return NULL;
 }
 
-void *hash_map_delete(hash_map_t *map, const char *key, hash_t key_hash)
+/* stage 0: the bucket; 1: the first item in it */
+static void chained_prefetch(hash_map_t *map, hash_t hash, int stage)
+{
+	hash_map_item_t **bucket = chained_bucket(map, hash);
+
+	if (stage == 0)
+		__builtin_prefetch(bucket);
+	else if (*bucket != NULL)
+		__builtin_prefetch(*bucket);
+}
+
+static void *chained_delete(hash_map_t *map, const void *key, hash_t hash)
 {
 	void *val = NULL;
-	hash_t hash;
-	size_t pos;
-	hash_map_item_t *prev = NULL, *item;
+	hash_map_item_t **bucket, *prev = NULL, *item;
 
-	hash = key ? hash_fn(key, -1) : key_hash;
-	pos = GET_POOL_POS(map, hash);
-	item = map->pool[pos];
+	bucket = chained_bucket(map, hash);
+	item = *bucket;
 	while (item != NULL) {
 		if (item->hash == hash) {
-			hash_check_key("delete", item, key);
-			if (strcmp(item->key, key) == 0) {
+			hash_check_key(map, "delete", item, key);
+			if (hash_key_match(map, item->key, key)) {
 				break;
 			}
 		}
@@ -204,36 +504,44 @@ void *hash_map_delete(hash_map_t *map, const char *key, hash_t key_hash)
 		if (prev != NULL)
 			prev->next = item->next;
 		else
-			map->pool[pos] = item->next;
-		safe_free(item->key);
-		safe_free(item);
+			*bucket = item->next;
+		if (!MAP_USES_ARENA(map))
+			safe_free(item);
 		map->count -= 1;
+		if (hash_map_should_shrink(map))
+			chained_resize(map, hash_map_shrink_capacity(map));
 	}
 	return val;
 }
 
-void hash_map_it_init(hash_map_iterator_t *it, hash_map_t *map)
+/**
+ * Iterator positions [0 .. old_capacity) walk the old pool (while a
+ * rehash is in progress) and the ones after that walk the current pool.
+ * Deleting the item last returned is safe as deletes don't move buckets.
+ */
+static hash_map_item_t *chained_it_bucket(hash_map_t *map, size_t pos)
 {
-	it->map = map;
-	it->item = NULL;
-	it->pos = 0;
+	if (pos < map->old_capacity)
+		return map->old_pool[pos];
+	return map->pool[pos - map->old_capacity];
 }
 
-int hash_map_it_next(hash_map_iterator_t *it, char **key, void **val)
+static int chained_it_next(hash_map_iterator_t *it, char **key, void **val)
 {
+	size_t nr_buckets;
 	hash_map_item_t *cur;
 
 	if (it->item != NULL) {
 		cur = it->item;
 		it->item = cur->next;
 	} else {
-		while (it->pos < it->map->capacity &&
-		       it->map->pool[it->pos] == NULL)
+		nr_buckets = it->map->old_capacity + it->map->capacity;
+		while (it->pos < nr_buckets &&
+		       chained_it_bucket(it->map, it->pos) == NULL)
 			it->pos++;
-		if (it->pos >= it->map->capacity ||
-		    it->map->pool[it->pos] == NULL)
+		if (it->pos >= nr_buckets)
 			return -1;
-		cur = it->map->pool[it->pos];
+		cur = chained_it_bucket(it->map, it->pos);
 		it->item = cur->next;
 		it->pos++;
 	}
@@ -241,3 +549,1209 @@ int hash_map_it_next(hash_map_iterator_t *it, char **key, void **val)
 	*val = cur->val;
 	return 0;
 }
+
+/* --- HASH_MAP_FLAG_READ_MOSTLY --- */
+
+/**
+ * Epoch based reclamation, shared by all READ_MOSTLY maps. Each thread that
+ * does a lookup gets a reader record; while in a lookup the record holds the
+ * global epoch it saw on entry, and 0 otherwise. A writer that unlinked
+ * something bumps the global epoch and waits till no record holds an epoch
+ * older than the new one. A reader that entered after the bump can't reach
+ * what was unlinked before it, so it can be freed after that wait.
+ *
+ * The reader's epoch store has to be ordered before its loads. Where the
+ * kernel supports it, membarrier() lets the writer force that ordering on
+ * all threads, so the reader only needs a compiler barrier instead of a
+ * full fence on every lookup.
+ */
+#define HASH_MAP_RCU_CACHE_LINE       64
+#define HASH_MAP_RCU_BATCH            64
+
+struct hash_map_rcu_reader {
+	uint64_t epoch;
+	bool in_use;
+	struct hash_map_rcu_reader *next;
+} __attribute__((aligned(HASH_MAP_RCU_CACHE_LINE)));
+
+static struct {
+	uint64_t epoch;
+	struct hash_map_rcu_reader *readers;
+	pthread_mutex_t lock;
+	pthread_key_t key;
+	pthread_once_t once;
+	bool membarrier;
+} g_hash_map_rcu = {
+	.epoch = 1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.once = PTHREAD_ONCE_INIT,
+};
+
+static __thread struct hash_map_rcu_reader *t_hash_map_rcu_reader;
+
+/* bucket array as seen by readers; pool and capacity change together */
+struct hash_map_rcu_table {
+	size_t capacity;
+	hash_map_item_t *pool[];
+};
+
+struct hash_map_rcu {
+	pthread_mutex_t lock;
+	struct hash_map_rcu_table *table;
+	void **retired;
+	size_t nr_retired;
+	size_t retired_size;
+};
+
+/* records are never freed, a thread that exits hands its record over */
+static void rcu_reader_release(void *arg)
+{
+	struct hash_map_rcu_reader *reader = arg;
+
+	__atomic_store_n(&reader->in_use, false, __ATOMIC_RELEASE);
+}
+
+static void rcu_key_create(void)
+{
+	pthread_key_create(&g_hash_map_rcu.key, rcu_reader_release);
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (syscall(SYS_membarrier,
+		    MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0)
+		g_hash_map_rcu.membarrier = true;
+#endif
+}
+
+/* a full barrier on every thread of the process, writer side */
+static void rcu_barrier_all(void)
+{
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (g_hash_map_rcu.membarrier &&
+	    syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0) == 0)
+		return;
+#endif
+	/* readers fence on their own, see rcu_read_lock() */
+}
+
+static struct hash_map_rcu_reader *rcu_reader_get(void)
+{
+	struct hash_map_rcu_reader *reader = t_hash_map_rcu_reader;
+
+	if (likely(reader != NULL))
+		return reader;
+
+	pthread_once(&g_hash_map_rcu.once, rcu_key_create);
+	pthread_mutex_lock(&g_hash_map_rcu.lock);
+	reader = g_hash_map_rcu.readers;
+	while (reader != NULL && reader->in_use)
+		reader = reader->next;
+	if (reader == NULL) {
+		reader = safe_aligned_alloc(HASH_MAP_RCU_CACHE_LINE,
+					    sizeof(*reader));
+		reader->next = g_hash_map_rcu.readers;
+		g_hash_map_rcu.readers = reader;
+	}
+	reader->epoch = 0;
+	reader->in_use = true;
+	pthread_mutex_unlock(&g_hash_map_rcu.lock);
+
+	pthread_setspecific(g_hash_map_rcu.key, reader);
+	t_hash_map_rcu_reader = reader;
+	return reader;
+}
+
+static inline struct hash_map_rcu_reader *rcu_read_lock(void)
+{
+	struct hash_map_rcu_reader *reader = rcu_reader_get();
+
+	__atomic_store_n(&reader->epoch,
+			 __atomic_load_n(&g_hash_map_rcu.epoch, __ATOMIC_RELAXED),
+			 __ATOMIC_RELAXED);
+	/* order the epoch store before the loads of the lookup */
+	if (g_hash_map_rcu.membarrier)
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	else
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return reader;
+}
+
+static inline void rcu_read_unlock(struct hash_map_rcu_reader *reader)
+{
+	__atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* wait till all lookups that started before this call have finished */
+static void rcu_synchronize(void)
+{
+	uint64_t epoch, seen;
+	struct hash_map_rcu_reader *reader;
+
+	epoch = __atomic_add_fetch(&g_hash_map_rcu.epoch, 1, __ATOMIC_SEQ_CST);
+	rcu_barrier_all();
+	pthread_mutex_lock(&g_hash_map_rcu.lock);
+	for (reader = g_hash_map_rcu.readers; reader; reader = reader->next) {
+		for (;;) {
+			seen = __atomic_load_n(&reader->epoch, __ATOMIC_ACQUIRE);
+			if (seen == 0 || seen >= epoch)
+				break;
+			sched_yield();
+		}
+	}
+	pthread_mutex_unlock(&g_hash_map_rcu.lock);
+}
+
+static void rcu_flush(struct hash_map_rcu *rcu)
+{
+	size_t i;
+
+	if (rcu->nr_retired == 0)
+		return;
+	rcu_synchronize();
+	for (i = 0; i < rcu->nr_retired; i++)
+		safe_free(rcu->retired[i]);
+	rcu->nr_retired = 0;
+}
+
+static void rcu_retire(struct hash_map_rcu *rcu, void *p)
+{
+	if (rcu->nr_retired == rcu->retired_size) {
+		rcu->retired_size = MAX(rcu->retired_size * 2,
+					(size_t)HASH_MAP_RCU_BATCH);
+		rcu->retired = safe_realloc(rcu->retired,
+					    rcu->retired_size * sizeof(void *));
+	}
+	rcu->retired[rcu->nr_retired++] = p;
+}
+
+static struct hash_map_rcu_table *rcu_table_new(hash_map_t *map,
+						size_t capacity)
+{
+	struct hash_map_rcu_table *table;
+
+	table = safe_calloc(1, sizeof(*table) +
+			       capacity * sizeof(hash_map_item_t *));
+	table->capacity = capacity;
+	map->pool = table->pool;
+	map->capacity = capacity;
+	return table;
+}
+
+/**
+ * Items can't be relinked in place as a lookup walking a chain would be
+ * led into another one. Instead, copies of all items are put into a new
+ * table that is published in one store, and the old ones are retired.
+ */
+static void rcu_resize(hash_map_t *map, size_t capacity)
+{
+	size_t pos, target;
+	struct hash_map_rcu *rcu = map->rcu;
+	struct hash_map_rcu_table *old, *table;
+	hash_map_item_t *item, *copy;
+
+	old = rcu->table;
+	table = rcu_table_new(map, capacity);
+	for (pos = 0; pos < old->capacity; pos++) {
+		for (item = old->pool[pos]; item; item = item->next) {
+			copy = chained_item_new(map, item->key, item->hash,
+						item->val);
+			target = GET_POOL_POS(map, item->hash);
+			copy->next = table->pool[target];
+			table->pool[target] = copy;
+			rcu_retire(rcu, item);
+		}
+	}
+	__atomic_store_n(&rcu->table, table, __ATOMIC_RELEASE);
+	rcu_retire(rcu, old);
+	rcu_flush(rcu);
+}
+
+static void rcu_init(hash_map_t *map, size_t capacity)
+{
+	map->rcu = safe_calloc(1, sizeof(struct hash_map_rcu));
+	pthread_mutex_init(&map->rcu->lock, NULL);
+	map->rcu->table = rcu_table_new(map, capacity);
+}
+
+static void rcu_free(hash_map_t *map, hash_map_callback_t callback)
+{
+	struct hash_map_rcu *rcu = map->rcu;
+
+	chained_free_items(map, map->pool, map->capacity, callback);
+	safe_free(rcu->table);
+	rcu_flush(rcu);
+	safe_free(rcu->retired);
+	pthread_mutex_destroy(&rcu->lock);
+	safe_free(rcu);
+	map->rcu = NULL;
+	map->pool = NULL;
+}
+
+static hash_t rcu_insert(hash_map_t *map, const void *key,
+			 hash_t hash, void *val)
+{
+	hash_map_item_t **bucket, *prev = NULL, *item;
+
+	pthread_mutex_lock(&map->rcu->lock);
+	if (MAP_NEEDS_GROW(map))
+		rcu_resize(map, map->capacity << 1);
+
+	bucket = map->pool + GET_POOL_POS(map, hash);
+	for (item = *bucket; item != NULL; item = item->next) {
+		if (item->hash == hash && hash_key_match(map, item->key, key)) {
+			__atomic_store_n(&item->val, val, __ATOMIC_RELEASE);
+			goto out;
+		}
+		prev = item;
+	}
+
+	/* item is fully built before it is made reachable */
+	item = chained_item_new(map, key, hash, val);
+	__atomic_store_n(prev ? &prev->next : bucket, item, __ATOMIC_RELEASE);
+	map->count += 1;
+out:
+	pthread_mutex_unlock(&map->rcu->lock);
+	return hash;
+}
+
+static void *rcu_get(hash_map_t *map, const void *key, hash_t hash)
+{
+	void *val = NULL;
+	struct hash_map_rcu_reader *reader;
+	struct hash_map_rcu_table *table;
+	hash_map_item_t *item;
+
+	reader = rcu_read_lock();
+	table = __atomic_load_n(&map->rcu->table, __ATOMIC_ACQUIRE);
+	item = __atomic_load_n(&table->pool[hash & (table->capacity - 1)],
+			       __ATOMIC_ACQUIRE);
+	while (item != NULL) {
+		if (item->hash == hash && hash_key_match(map, item->key, key)) {
+			val = __atomic_load_n(&item->val, __ATOMIC_ACQUIRE);
+			break;
+		}
+		item = __atomic_load_n(&item->next, __ATOMIC_ACQUIRE);
+	}
+	rcu_read_unlock(reader);
+	return val;
+}
+
+static void *rcu_delete(hash_map_t *map, const void *key, hash_t hash)
+{
+	void *val = NULL;
+	hash_map_item_t **bucket, *prev = NULL, *item;
+
+	pthread_mutex_lock(&map->rcu->lock);
+	bucket = map->pool + GET_POOL_POS(map, hash);
+	for (item = *bucket; item != NULL; item = item->next) {
+		if (item->hash == hash && hash_key_match(map, item->key, key))
+			break;
+		prev = item;
+	}
+	if (item != NULL) {
+		/* lookups on item still find their way through item->next */
+		__atomic_store_n(prev ? &prev->next : bucket, item->next,
+				 __ATOMIC_RELEASE);
+		val = item->val;
+		map->count -= 1;
+		rcu_retire(map->rcu, item);
+		if (hash_map_should_shrink(map))
+			rcu_resize(map, hash_map_shrink_capacity(map));
+		else if (map->rcu->nr_retired >= HASH_MAP_RCU_BATCH)
+			rcu_flush(map->rcu);
+	}
+	pthread_mutex_unlock(&map->rcu->lock);
+	return val;
+}
+
+static void rcu_compact(hash_map_t *map)
+{
+	size_t capacity;
+
+	pthread_mutex_lock(&map->rcu->lock);
+	capacity = hash_map_fit_capacity(map, map->count);
+	if (capacity != map->capacity)
+		rcu_resize(map, capacity);
+	pthread_mutex_unlock(&map->rcu->lock);
+}
+
+/* --- HASH_MAP_TYPE_OPEN --- */
+
+/*
+ * Each slot has a control byte in map->ctrl. A full slot holds the low 7
+ * bits of the hash (H2) so that most mismatches are rejected without going
+ * to the hashes array, let alone the key. The remaining hash bits (H1) pick
+ * the group of HASH_MAP_GROUP_WIDTH slots where the probe starts.
+ *
+ * The control bytes of a group are compared against a tag in one go and
+ * give out a bit mask of matching slots. A group with an empty slot ends
+ * the probe, so a miss usually costs one vector compare.
+ */
+#define CTRL_EMPTY                    0x80
+#define CTRL_DELETED                  0xfe
+#define CTRL_IS_FULL(c)               (((c) & 0x80) == 0)
+#define HASH_H1(hash)                 ((size_t)((hash) >> 7))
+#define HASH_H2(hash)                 ((uint8_t)((hash) & 0x7f))
+
+#define HASH_MAP_GROUP_WIDTH          16
+
+typedef uint64_t group_mask_t;
+
+#if defined(__SSE2__) && !defined(HASH_MAP_NO_SIMD)
+
+#include <emmintrin.h>
+
+#define GROUP_MASK_SHIFT              0
+#define GROUP_MASK_ALL                0xffffull
+
+static inline group_mask_t group_match(const uint8_t *ctrl, uint8_t tag)
+{
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+
+	return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)tag)));
+}
+
+/* empty and deleted are the only control bytes with the top bit set */
+static inline group_mask_t group_match_free(const uint8_t *ctrl)
+{
+	return (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+
+#elif defined(__ARM_NEON) && !defined(HASH_MAP_NO_SIMD)
+
+#include <arm_neon.h>
+
+/* NEON has no movemask; narrow each byte of the compare to a nibble */
+#define GROUP_MASK_SHIFT              2
+#define GROUP_MASK_ALL                0x8888888888888888ull
+
+static inline group_mask_t neon_group_mask(uint8x16_t cmp)
+{
+	uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+
+	return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) &
+	       0x8888888888888888ull;
+}
+
+static inline group_mask_t group_match(const uint8_t *ctrl, uint8_t tag)
+{
+	return neon_group_mask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(tag)));
+}
+
+static inline group_mask_t group_match_free(const uint8_t *ctrl)
+{
+	return neon_group_mask(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(ctrl)),
+				       vdupq_n_s8(0)));
+}
+
+#else
+
+#define GROUP_MASK_SHIFT              0
+#define GROUP_MASK_ALL                0xffffull
+
+static inline group_mask_t group_match(const uint8_t *ctrl, uint8_t tag)
+{
+	int i;
+	group_mask_t mask = 0;
+
+	for (i = 0; i < HASH_MAP_GROUP_WIDTH; i++)
+		mask |= (group_mask_t)(ctrl[i] == tag) << i;
+	return mask;
+}
+
+static inline group_mask_t group_match_free(const uint8_t *ctrl)
+{
+	int i;
+	group_mask_t mask = 0;
+
+	for (i = 0; i < HASH_MAP_GROUP_WIDTH; i++)
+		mask |= (group_mask_t)(ctrl[i] >> 7) << i;
+	return mask;
+}
+
+#endif
+
+static inline group_mask_t group_match_empty(const uint8_t *ctrl)
+{
+	return group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline group_mask_t group_match_full(const uint8_t *ctrl)
+{
+	return group_match_free(ctrl) ^ GROUP_MASK_ALL;
+}
+
+/* index (within the group) of the lowest slot set in a non-zero mask */
+#define GROUP_MASK_FIRST(mask)        ((size_t)__builtin_ctzll(mask) >> GROUP_MASK_SHIFT)
+
+/* first full control byte in [pos .. end), a group at a time; or end */
+static size_t ctrl_next_full(const uint8_t *ctrl, size_t pos, size_t end)
+{
+	group_mask_t mask;
+
+	while (pos + HASH_MAP_GROUP_WIDTH <= end) {
+		mask = group_match_full(ctrl + pos);
+		if (mask)
+			return pos + GROUP_MASK_FIRST(mask);
+		pos += HASH_MAP_GROUP_WIDTH;
+	}
+	while (pos < end && !CTRL_IS_FULL(ctrl[pos]))
+		pos++;
+	return pos;
+}
+
+/*
+ * Groups are visited in triangular steps (+1, +2, +3, ...) which covers
+ * every group once when the group count is a power of 2.
+ */
+#define GROUP_PROBE_NEXT(g, i, mask)  (((g) + (++(i))) & (mask))
+
+/**
+ * Slots are map->slot_size bytes apart; inline keys (see MAP_KEY_INLINE)
+ * are held right after the value and the rest are held as a char pointer.
+ */
+typedef struct {
+	void *val;
+	uint8_t key[];
+} hash_map_slot_t;
+
+#define OPEN_SLOT(map, pos) \
+		((hash_map_slot_t *)((uint8_t *)(map)->slots + (pos) * (map)->slot_size))
+
+static inline char *open_slot_key(hash_map_t *map, hash_map_slot_t *slot)
+{
+	if (MAP_KEY_INLINE(map))
+		return (char *)slot->key;
+	return *(char **)slot->key;
+}
+
+static inline void open_slot_set_key(hash_map_t *map, hash_map_slot_t *slot,
+				     const void *key)
+{
+	if (MAP_KEY_INLINE(map))
+		memcpy(slot->key, key, map->key_len);
+	else if (map->flags & HASH_MAP_FLAG_BORROW_KEYS)
+		*(const void **)slot->key = key;
+	else if (MAP_USES_ARENA(map))
+		*(char **)slot->key = arena_strdup(&map->arena, key);
+	else
+		*(char **)slot->key = safe_strdup(key);
+}
+
+static inline void open_slot_free_key(hash_map_t *map, hash_map_slot_t *slot)
+{
+	if (!MAP_KEY_INLINE(map) &&
+	    !(map->flags & (HASH_MAP_FLAG_BORROW_KEYS | HASH_MAP_FLAG_ARENA)))
+		safe_free(*(char **)slot->key);
+}
+
+static void open_init(hash_map_t *map, size_t capacity)
+{
+	capacity = MAX(capacity, (size_t)HASH_MAP_GROUP_WIDTH);
+	map->ctrl = safe_malloc(capacity);
+	memset(map->ctrl, CTRL_EMPTY, capacity);
+	map->hashes = safe_malloc(capacity * sizeof(hash_t));
+	map->slot_size = sizeof(hash_map_slot_t) + ROUND_UP(MAP_KEY_INLINE(map) ?
+				map->key_len : sizeof(char *), sizeof(void *));
+	map->slots = safe_malloc(capacity * map->slot_size);
+	map->capacity = capacity;
+	map->deleted = 0;
+}
+
+static void open_free_slots(hash_map_t *map, size_t nr_slots,
+			    hash_map_callback_t callback)
+{
+	size_t pos;
+	hash_map_slot_t *slot;
+
+	if (MAP_USES_ARENA(map) && callback == NULL)
+		return;
+
+	for (pos = 0; pos < nr_slots; pos++) {
+		if (!CTRL_IS_FULL(map->ctrl[pos]))
+			continue;
+		slot = OPEN_SLOT(map, pos);
+		if (callback)
+			callback(open_slot_key(map, slot), slot->val);
+		open_slot_free_key(map, slot);
+	}
+}
+
+static void open_free(hash_map_t *map, hash_map_callback_t callback)
+{
+	open_free_slots(map, map->capacity, callback);
+	safe_free(map->ctrl);
+	safe_free(map->hashes);
+	safe_free(map->slots);
+	map->ctrl = NULL;
+	map->hashes = NULL;
+	map->slots = NULL;
+	map->deleted = 0;
+	arena_free(&map->arena);
+}
+
+/* first slot that is not full along the probe sequence of hash */
+static size_t open_find_free(hash_map_t *map, hash_t hash)
+{
+	size_t i = 0, gmask = map->capacity / HASH_MAP_GROUP_WIDTH - 1;
+	size_t g = HASH_H1(hash) & gmask;
+	group_mask_t mask;
+
+	/* density is capped below 1, so some group always has a free slot */
+	while (!(mask = group_match_free(map->ctrl + g * HASH_MAP_GROUP_WIDTH)))
+		g = GROUP_PROBE_NEXT(g, i, gmask);
+	return g * HASH_MAP_GROUP_WIDTH + GROUP_MASK_FIRST(mask);
+}
+
+static size_t open_find(hash_map_t *map, const void *key, hash_t hash)
+{
+	size_t pos, i = 0, gmask = map->capacity / HASH_MAP_GROUP_WIDTH - 1;
+	size_t g = HASH_H1(hash) & gmask;
+	const uint8_t *ctrl;
+	group_mask_t mask;
+
+	while (1) {
+		ctrl = map->ctrl + g * HASH_MAP_GROUP_WIDTH;
+		mask = group_match(ctrl, HASH_H2(hash));
+		while (mask) {
+			pos = g * HASH_MAP_GROUP_WIDTH + GROUP_MASK_FIRST(mask);
+			if (map->hashes[pos] == hash &&
+			    hash_key_match(map, open_slot_key(map, OPEN_SLOT(map, pos)), key))
+				return pos;
+			mask &= mask - 1;
+		}
+		if (group_match_empty(ctrl))
+			return SIZE_MAX;
+		g = GROUP_PROBE_NEXT(g, i, gmask);
+	}
+}
+
+/* stage 0: control bytes of the first group; 1: first slot with a tag match */
+static void open_prefetch(hash_map_t *map, hash_t hash, int stage)
+{
+	size_t pos, g = HASH_H1(hash) & (map->capacity / HASH_MAP_GROUP_WIDTH - 1);
+	group_mask_t mask;
+
+	if (stage == 0) {
+		__builtin_prefetch(map->ctrl + g * HASH_MAP_GROUP_WIDTH);
+		return;
+	}
+	mask = group_match(map->ctrl + g * HASH_MAP_GROUP_WIDTH, HASH_H2(hash));
+	if (mask) {
+		pos = g * HASH_MAP_GROUP_WIDTH + GROUP_MASK_FIRST(mask);
+		__builtin_prefetch(map->hashes + pos);
+		__builtin_prefetch(OPEN_SLOT(map, pos));
+	}
+}
+
+static void open_resize(hash_map_t *map, size_t capacity)
+{
+	size_t pos, target, old_capacity = map->capacity;
+	uint8_t *old_ctrl = map->ctrl;
+	hash_t *old_hashes = map->hashes;
+	uint8_t *old_slots = map->slots;
+
+	open_init(map, capacity);
+	for (pos = 0; pos < old_capacity; pos++) {
+		if (!CTRL_IS_FULL(old_ctrl[pos]))
+			continue;
+		target = open_find_free(map, old_hashes[pos]);
+		map->ctrl[target] = old_ctrl[pos];
+		map->hashes[target] = old_hashes[pos];
+		memcpy(OPEN_SLOT(map, target), old_slots + pos * map->slot_size,
+		       map->slot_size);
+	}
+	safe_free(old_ctrl);
+	safe_free(old_hashes);
+	safe_free(old_slots);
+}
+
+static hash_t open_insert(hash_map_t *map, const void *key,
+			  hash_t hash, void *val)
+{
+	size_t pos;
+	hash_map_slot_t *slot;
+
+	pos = open_find(map, key, hash);
+	if (pos != SIZE_MAX) {
+		OPEN_SLOT(map, pos)->val = val;
+		return hash;
+	}
+
+	/* tombstones count towards density as they lengthen the probes */
+	if ((double)(map->count + map->deleted + 1) >
+	    (double)map->capacity * map->load_factor) {
+		if ((double)(map->count + 1) >
+		    (double)map->capacity * map->load_factor / 2)
+			open_resize(map, map->capacity << 1);
+		else
+			open_resize(map, map->capacity);
+	}
+
+	pos = open_find_free(map, hash);
+	if (map->ctrl[pos] == CTRL_DELETED)
+		map->deleted -= 1;
+	map->ctrl[pos] = HASH_H2(hash);
+	map->hashes[pos] = hash;
+	slot = OPEN_SLOT(map, pos);
+	open_slot_set_key(map, slot, key);
+	slot->val = val;
+	map->count += 1;
+	return hash;
+}
+
+static void *open_get(hash_map_t *map, const void *key, hash_t hash)
+{
+	size_t pos;
+
+	pos = open_find(map, key, hash);
+	if (pos == SIZE_MAX)
+		return NULL;
+	return OPEN_SLOT(map, pos)->val;
+}
+
+static void *open_delete(hash_map_t *map, const void *key, hash_t hash)
+{
+	size_t pos;
+	void *val;
+	hash_map_slot_t *slot;
+
+	pos = open_find(map, key, hash);
+	if (pos == SIZE_MAX)
+		return NULL;
+
+	/**
+	 * A group turns full only once between rehashes. So if this group
+	 * still has an empty slot no probe sequence ever went past it and
+	 * the slot can be emptied; else it has to become a tombstone to keep
+	 * later entries of those sequences reachable.
+	 */
+	if (group_match_empty(map->ctrl + pos - pos % HASH_MAP_GROUP_WIDTH)) {
+		map->ctrl[pos] = CTRL_EMPTY;
+	} else {
+		map->ctrl[pos] = CTRL_DELETED;
+		map->deleted += 1;
+	}
+	slot = OPEN_SLOT(map, pos);
+	open_slot_free_key(map, slot);
+	val = slot->val;
+	map->count -= 1;
+	if (hash_map_should_shrink(map))
+		open_resize(map, hash_map_shrink_capacity(map));
+	return val;
+}
+
+/* only STRING keys that are not borrowed live in the arena */
+static void open_rebuild_arena(hash_map_t *map, size_t nr_slots)
+{
+	size_t pos;
+	arena_t old = map->arena;
+	hash_map_slot_t *slot;
+
+	if (MAP_KEY_INLINE(map) || (map->flags & HASH_MAP_FLAG_BORROW_KEYS))
+		return;
+	arena_init(&map->arena, old.chunk_size);
+	for (pos = 0; pos < nr_slots; pos++) {
+		if (!CTRL_IS_FULL(map->ctrl[pos]))
+			continue;
+		slot = OPEN_SLOT(map, pos);
+		open_slot_set_key(map, slot, open_slot_key(map, slot));
+	}
+	arena_free(&old);
+}
+
+/* rebuilding at any size also drops the tombstones */
+static void open_compact(hash_map_t *map)
+{
+	size_t capacity = hash_map_fit_capacity(map, map->count);
+
+	if (capacity != map->capacity || map->deleted)
+		open_resize(map, capacity);
+	if (MAP_USES_ARENA(map))
+		open_rebuild_arena(map, map->capacity);
+}
+
+static int open_it_next(hash_map_iterator_t *it, char **key, void **val)
+{
+	hash_map_t *map = it->map;
+	hash_map_slot_t *slot;
+
+	it->pos = ctrl_next_full(map->ctrl, it->pos, map->capacity);
+	if (it->pos >= map->capacity)
+		return -1;
+	slot = OPEN_SLOT(map, it->pos);
+	*key = open_slot_key(map, slot);
+	*val = slot->val;
+	it->pos++;
+	return 0;
+}
+
+/* --- HASH_MAP_TYPE_ORDERED --- */
+
+/**
+ * Entries live in a dense array (map->slots, map->hashes and map->ctrl, one
+ * element per entry) in insertion order. The hash index is a power of 2
+ * sized array of entry numbers (plus one) probed linearly. Deleting an
+ * entry only marks it dead in ctrl and leaves a tombstone in the index;
+ * entries are never moved on delete, so iterating over the entries stays
+ * valid across deletes. Dead entries are squeezed out when the entries
+ * array fills up (on insert) or on hash_map_compact().
+ *
+ * Every used index slot, tombstone or not, refers to an entry appended
+ * since the last rebuild, and the entries array is capped below the index
+ * capacity by the load factor. So a probe always ends on an empty slot.
+ */
+#define INDEX_EMPTY                   0
+#define INDEX_DELETED                 UINT32_MAX
+#define INDEX_ENTRY(v)                ((size_t)(v) - 1)
+
+static void ordered_init(hash_map_t *map, size_t capacity)
+{
+	capacity = MAX(capacity, (size_t)HASH_MAP_BASE_SIZE);
+	map->index = safe_calloc(capacity, sizeof(uint32_t));
+	map->max_entries = MAX((size_t)((double)capacity * map->load_factor),
+			       (size_t)1);
+	map->ctrl = safe_malloc(map->max_entries);
+	map->hashes = safe_malloc(map->max_entries * sizeof(hash_t));
+	map->slot_size = sizeof(hash_map_slot_t) + ROUND_UP(MAP_KEY_INLINE(map) ?
+				map->key_len : sizeof(char *), sizeof(void *));
+	map->slots = safe_malloc(map->max_entries * map->slot_size);
+	map->capacity = capacity;
+	map->nr_entries = 0;
+	map->deleted = 0;
+}
+
+static void ordered_free(hash_map_t *map, hash_map_callback_t callback)
+{
+	open_free_slots(map, map->nr_entries, callback);
+	safe_free(map->index);
+	safe_free(map->ctrl);
+	safe_free(map->hashes);
+	safe_free(map->slots);
+	map->index = NULL;
+	map->ctrl = NULL;
+	map->hashes = NULL;
+	map->slots = NULL;
+	map->nr_entries = 0;
+	map->max_entries = 0;
+	map->deleted = 0;
+	arena_free(&map->arena);
+}
+
+/* index position holding key, or SIZE_MAX */
+static size_t ordered_find(hash_map_t *map, const void *key, hash_t hash)
+{
+	uint32_t v;
+	size_t pos, mask = map->capacity - 1;
+
+	for (pos = hash & mask; ; pos = (pos + 1) & mask) {
+		v = map->index[pos];
+		if (v == INDEX_EMPTY)
+			return SIZE_MAX;
+		if (v != INDEX_DELETED && map->hashes[INDEX_ENTRY(v)] == hash &&
+		    hash_key_match(map, open_slot_key(map,
+				   OPEN_SLOT(map, INDEX_ENTRY(v))), key))
+			return pos;
+	}
+}
+
+/* first empty or tombstone index position along the probe of hash */
+static size_t ordered_find_free(hash_map_t *map, hash_t hash)
+{
+	size_t pos, mask = map->capacity - 1;
+
+	pos = hash & mask;
+	while (map->index[pos] != INDEX_EMPTY &&
+	       map->index[pos] != INDEX_DELETED)
+		pos = (pos + 1) & mask;
+	return pos;
+}
+
+/* drop dead entries into arrays sized for capacity, keeping the order */
+static void ordered_resize(hash_map_t *map, size_t capacity)
+{
+	size_t i, n = 0, nr_entries = map->nr_entries;
+	uint32_t *old_index = map->index;
+	uint8_t *old_ctrl = map->ctrl;
+	hash_t *old_hashes = map->hashes;
+	uint8_t *old_slots = map->slots;
+
+	ordered_init(map, capacity);
+	for (i = 0; i < nr_entries; i++) {
+		if (!CTRL_IS_FULL(old_ctrl[i]))
+			continue;
+		map->ctrl[n] = old_ctrl[i];
+		map->hashes[n] = old_hashes[i];
+		memcpy(OPEN_SLOT(map, n), old_slots + i * map->slot_size,
+		       map->slot_size);
+		map->index[ordered_find_free(map, old_hashes[i])] = n + 1;
+		n++;
+	}
+	map->nr_entries = n;
+	safe_free(old_index);
+	safe_free(old_ctrl);
+	safe_free(old_hashes);
+	safe_free(old_slots);
+}
+
+static hash_t ordered_insert(hash_map_t *map, const void *key,
+			     hash_t hash, void *val)
+{
+	size_t pos, entry;
+	hash_map_slot_t *slot;
+
+	pos = ordered_find(map, key, hash);
+	if (pos != SIZE_MAX) {
+		OPEN_SLOT(map, INDEX_ENTRY(map->index[pos]))->val = val;
+		return hash;
+	}
+
+	/* grow only if squeezing out dead entries doesn't make enough room */
+	if (map->nr_entries == map->max_entries) {
+		if ((double)(map->count + 1) >
+		    (double)map->capacity * map->load_factor / 2)
+			ordered_resize(map, map->capacity << 1);
+		else
+			ordered_resize(map, map->capacity);
+	}
+
+	pos = ordered_find_free(map, hash);
+	if (map->index[pos] == INDEX_DELETED)
+		map->deleted -= 1;
+	entry = map->nr_entries++;
+	map->index[pos] = entry + 1;
+	map->ctrl[entry] = HASH_H2(hash);
+	map->hashes[entry] = hash;
+	slot = OPEN_SLOT(map, entry);
+	open_slot_set_key(map, slot, key);
+	slot->val = val;
+	map->count += 1;
+	return hash;
+}
+
+static void *ordered_get(hash_map_t *map, const void *key, hash_t hash)
+{
+	size_t pos;
+
+	pos = ordered_find(map, key, hash);
+	if (pos == SIZE_MAX)
+		return NULL;
+	return OPEN_SLOT(map, INDEX_ENTRY(map->index[pos]))->val;
+}
+
+static void *ordered_delete(hash_map_t *map, const void *key, hash_t hash)
+{
+	size_t pos, entry;
+	void *val;
+	hash_map_slot_t *slot;
+
+	pos = ordered_find(map, key, hash);
+	if (pos == SIZE_MAX)
+		return NULL;
+
+	entry = INDEX_ENTRY(map->index[pos]);
+	map->index[pos] = INDEX_DELETED;
+	map->ctrl[entry] = CTRL_DELETED;
+	map->deleted += 1;
+	slot = OPEN_SLOT(map, entry);
+	open_slot_free_key(map, slot);
+	val = slot->val;
+	map->count -= 1;
+	if (hash_map_should_shrink(map))
+		ordered_resize(map, hash_map_shrink_capacity(map));
+	return val;
+}
+
+static int ordered_it_next(hash_map_iterator_t *it, char **key, void **val)
+{
+	hash_map_t *map = it->map;
+	hash_map_slot_t *slot;
+
+	it->pos = ctrl_next_full(map->ctrl, it->pos, map->nr_entries);
+	if (it->pos >= map->nr_entries)
+		return -1;
+	slot = OPEN_SLOT(map, it->pos);
+	*key = open_slot_key(map, slot);
+	*val = slot->val;
+	it->pos++;
+	return 0;
+}
+
+/* stage 0: the index slot; 1: the entry it points to */
+static void ordered_prefetch(hash_map_t *map, hash_t hash, int stage)
+{
+	uint32_t v;
+	size_t pos = hash & (map->capacity - 1);
+
+	if (stage == 0) {
+		__builtin_prefetch(map->index + pos);
+		return;
+	}
+	v = map->index[pos];
+	if (v != INDEX_EMPTY && v != INDEX_DELETED) {
+		__builtin_prefetch(map->hashes + INDEX_ENTRY(v));
+		__builtin_prefetch(OPEN_SLOT(map, INDEX_ENTRY(v)));
+	}
+}
+
+static void ordered_compact(hash_map_t *map)
+{
+	size_t capacity = hash_map_fit_capacity(map, map->count);
+
+	if (capacity != map->capacity || map->nr_entries != map->count)
+		ordered_resize(map, capacity);
+	if (MAP_USES_ARENA(map))
+		open_rebuild_arena(map, map->nr_entries);
+}
+
+static const struct hash_map_ops g_hash_map_ops[HASH_MAP_TYPE_SENTINEL] = {
+	[HASH_MAP_TYPE_CHAINED] = {
+		.init = chained_init,
+		.free = chained_free,
+		.insert = chained_insert,
+		.get = chained_get,
+		.delete = chained_delete,
+		.it_next = chained_it_next,
+		.prefetch = chained_prefetch,
+		.compact = chained_compact,
+	},
+	[HASH_MAP_TYPE_OPEN] = {
+		.init = open_init,
+		.free = open_free,
+		.insert = open_insert,
+		.get = open_get,
+		.delete = open_delete,
+		.it_next = open_it_next,
+		.prefetch = open_prefetch,
+		.compact = open_compact,
+	},
+	[HASH_MAP_TYPE_ORDERED] = {
+		.init = ordered_init,
+		.free = ordered_free,
+		.insert = ordered_insert,
+		.get = ordered_get,
+		.delete = ordered_delete,
+		.it_next = ordered_it_next,
+		.prefetch = ordered_prefetch,
+		.compact = ordered_compact,
+	},
+};
+
+static const struct hash_map_ops g_hash_map_rcu_ops = {
+	.init = rcu_init,
+	.free = rcu_free,
+	.insert = rcu_insert,
+	.get = rcu_get,
+	.delete = rcu_delete,
+	.it_next = chained_it_next,
+	/* pool may be swapped under a reader; no prefetch */
+	.compact = rcu_compact,
+};
+
+#define MAP_OPS(map) \
+		(((map)->flags & HASH_MAP_FLAG_READ_MOSTLY) ? \
+		 &g_hash_map_rcu_ops : &g_hash_map_ops[(map)->type])
+
+/* --- public API --- */
+
+int hash_map_init_config(hash_map_t *map, const hash_map_config_t *config)
+{
+	hash_map_config_t def = { 0 };
+
+	if (config == NULL)
+		config = &def;
+	if ((unsigned)config->type >= HASH_MAP_TYPE_SENTINEL)
+		return -1;
+	if ((config->flags & (HASH_MAP_FLAG_INCREMENTAL_REHASH |
+			      HASH_MAP_FLAG_READ_MOSTLY)) &&
+	    config->type != HASH_MAP_TYPE_CHAINED)
+		return -1;
+	/* retired items are freed one by one */
+	if ((config->flags & HASH_MAP_FLAG_ARENA) &&
+	    (config->flags & HASH_MAP_FLAG_READ_MOSTLY))
+		return -1;
+	/* readers can't follow items between two pools */
+	if ((config->flags & HASH_MAP_FLAG_INCREMENTAL_REHASH) &&
+	    (config->flags & HASH_MAP_FLAG_READ_MOSTLY))
+		return -1;
+
+	memset(map, 0, sizeof(hash_map_t));
+	arena_init(&map->arena, 0);
+	map->type = config->type;
+	map->flags = config->flags;
+	map->key_type = config->key_type;
+	map->hash_fn = config->hash_fn;
+	map->seed = config->seed;
+	map->load_factor = config->load_factor;
+	if (map->load_factor == 0)
+		map->load_factor = HASH_MAP_DENSITY_FACTOR;
+	/* open addressing needs a free slot to end probes */
+	if (map->load_factor < 0 ||
+	    (map->type != HASH_MAP_TYPE_CHAINED && map->load_factor >= 1))
+		return -1;
+	/*
+	 * A shrink leaves the map more than load_factor / 4 full, which must
+	 * not be due for another shrink right away.
+	 */
+	map->shrink_factor = config->shrink_factor;
+	if (map->shrink_factor < 0 ||
+	    map->shrink_factor > map->load_factor / 4)
+		return -1;
+	if (config->flags & HASH_MAP_FLAG_RANDOM_SEED) {
+		if (!get_random_bytes((uint8_t *)&map->seed, sizeof(map->seed)))
+			return -1;
+		if (map->hash_fn == NULL)
+			map->hash_fn = hash_map_hash_wy;
+	}
+	switch (config->key_type) {
+	case HASH_MAP_KEY_STRING:
+		break;
+	case HASH_MAP_KEY_U64:
+		/* nothing to borrow, they are passed by value */
+		if (config->flags & HASH_MAP_FLAG_BORROW_KEYS)
+			return -1;
+		map->key_len = sizeof(uint64_t);
+		break;
+	case HASH_MAP_KEY_BINARY:
+		if (config->key_len == 0)
+			return -1;
+		map->key_len = config->key_len;
+		break;
+	default:
+		return -1;
+	}
+	MAP_OPS(map)->init(map, hash_map_fit_capacity(map, config->capacity));
+	return 0;
+}
+
+void hash_map_init(hash_map_t *map)
+{
+	hash_map_init_config(map, NULL);
+}
+
+int hash_map_init_capacity(hash_map_t *map, size_t capacity)
+{
+	hash_map_config_t config = { .capacity = capacity };
+
+	return hash_map_init_config(map, &config);
+}
+
+void hash_map_compact(hash_map_t *map)
+{
+	MAP_OPS(map)->compact(map);
+}
+
+void hash_map_free(hash_map_t *map, hash_map_callback_t callback)
+{
+	MAP_OPS(map)->free(map, callback);
+	map->capacity = 0;
+	map->count = 0;
+}
+
+hash_t hash_map_hash(hash_map_t *map, const void *key)
+{
+	return hash_key(map, key);
+}
+
+hash_t __hash_map_insert(hash_map_t *map, const void *key, hash_t hash, void *val)
+{
+	return MAP_OPS(map)->insert(map, key, hash, val);
+}
+
+void *__hash_map_get(hash_map_t *map, const void *key, hash_t hash)
+{
+	return MAP_OPS(map)->get(map, key, hash);
+}
+
+void *__hash_map_delete(hash_map_t *map, const void *key, hash_t hash)
+{
+	return MAP_OPS(map)->delete(map, key, hash);
+}
+
+hash_t hash_map_insert(hash_map_t *map, const void *key, void *val)
+{
+	return __hash_map_insert(map, key, hash_key(map, key), val);
+}
+
+void *hash_map_get(hash_map_t *map, const void *key, hash_t key_hash)
+{
+	hash_t hash;
+
+	hash = key ? hash_key(map, key) : key_hash;
+	return __hash_map_get(map, key, hash);
+}
+
+void *hash_map_delete(hash_map_t *map, const void *key, hash_t key_hash)
+{
+	hash_t hash;
+
+	hash = key ? hash_key(map, key) : key_hash;
+	return __hash_map_delete(map, key, hash);
+}
+
+/**
+ * Keys are handled in windows of HASH_MAP_BATCH: all keys of a window are
+ * hashed and the memory their probes start at is prefetched before any of
+ * them is resolved, so the cache misses of a window overlap instead of being
+ * taken one after the other. The second prefetch stage follows the first
+ * one's (by now cached) bucket/control bytes to the item/slot.
+ */
+#define HASH_MAP_BATCH                16
+
+static size_t hash_map_batch_prep(hash_map_t *map, const void * const *keys,
+				  size_t count, hash_t *hashes)
+{
+	size_t i, n = MIN(count, (size_t)HASH_MAP_BATCH);
+	const struct hash_map_ops *ops = MAP_OPS(map);
+
+	for (i = 0; i < n; i++) {
+		hashes[i] = hash_key(map, keys[i]);
+		if (ops->prefetch)
+			ops->prefetch(map, hashes[i], 0);
+	}
+	for (i = 0; ops->prefetch && i < n; i++)
+		ops->prefetch(map, hashes[i], 1);
+	return n;
+}
+
+void hash_map_insert_many(hash_map_t *map, const void * const *keys,
+			  void * const *vals, size_t count)
+{
+	size_t i, n, done;
+	hash_t hashes[HASH_MAP_BATCH];
+
+	for (done = 0; done < count; done += n) {
+		n = hash_map_batch_prep(map, keys + done, count - done, hashes);
+		for (i = 0; i < n; i++)
+			MAP_OPS(map)->insert(map, keys[done + i], hashes[i],
+					     vals[done + i]);
+	}
+}
+
+size_t hash_map_get_many(hash_map_t *map, const void * const *keys,
+			 void **vals, size_t count)
+{
+	size_t i, n, done, found = 0;
+	hash_t hashes[HASH_MAP_BATCH];
+
+	for (done = 0; done < count; done += n) {
+		n = hash_map_batch_prep(map, keys + done, count - done, hashes);
+		for (i = 0; i < n; i++) {
+			vals[done + i] = MAP_OPS(map)->get(map, keys[done + i],
+							   hashes[i]);
+			if (vals[done + i] != NULL)
+				found++;
+		}
+	}
+	return found;
+}
+
+void hash_map_it_init(hash_map_iterator_t *it, hash_map_t *map)
+{
+	it->map = map;
+	it->item = NULL;
+	it->pos = 0;
+}
+
+int hash_map_it_next(hash_map_iterator_t *it, char **key, void **val)
+{
+	return MAP_OPS(it->map)->it_next(it, key, val);
+}
@@ -8,7 +8,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <assert.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include <utils/utils.h>
+#include <utils/memory.h>
 
 static void die_oom(const char *msg, size_t count, size_t size)
 {
@@ -17,6 +28,8 @@ static void die_oom(const char *msg, size_t count, size_t size)
 	exit(-1);
 }
 
+#ifndef USE_MEMORY_STATS
+
 void safe_free(void *p)
 {
 	if (p != NULL) {
@@ -85,3 +98,493 @@ void *safe_realloc_zero(void *data, size_t old_size, size_t new_size)
 	return p;
 }
 
+
+void *safe_aligned_alloc(size_t align, size_t size)
+{
+	void *p;
+
+	if (posix_memalign(&p, align, size))
+		die_oom("aligned_alloc", 1, size);
+
+	return p;
+}
+
+int memory_stats_get(memory_stats_t *stats)
+{
+	ARG_UNUSED(stats);
+	return -1;
+}
+
+void memory_stats_dump(FILE *fp)
+{
+	ARG_UNUSED(fp);
+}
+
+#else /* USE_MEMORY_STATS */
+
+#define MEMORY_HDR_MAGIC              0x6d656d73U
+
+/**
+ * Every block is preceded by this header. It is 32 bytes so the block keeps
+ * the 16 byte alignment of malloc; `offset` is the distance from the start
+ * of the underlying allocation to the block (more than the header size for
+ * safe_aligned_alloc()).
+ */
+struct memory_hdr {
+	memory_site_t *site;
+	size_t size;
+	uint32_t offset;
+	uint32_t magic;
+	uint64_t reserved;
+};
+
+#define MEMORY_HDR_SIZE               sizeof(struct memory_hdr)
+
+static memory_stats_t g_memory_stats;
+static memory_site_t *g_memory_sites;
+
+/* used by the function forms below; for calls through function pointers */
+static memory_site_t g_memory_site_unknown = { .file = "<unknown>" };
+
+static inline struct memory_hdr *memory_hdr(void *p)
+{
+	struct memory_hdr *hdr = (struct memory_hdr *)((uint8_t *)p - MEMORY_HDR_SIZE);
+
+	assert(hdr->magic == MEMORY_HDR_MAGIC);
+	return hdr;
+}
+
+static inline size_t memory_bucket(size_t size)
+{
+	size_t bucket;
+
+	if (size <= 16)
+		return 0;
+	bucket = 64 - __builtin_clzll((unsigned long long)(size - 1)) - 4;
+	return MIN(bucket, (size_t)MEMORY_STATS_NR_BUCKETS - 1);
+}
+
+static void memory_site_register(memory_site_t *site)
+{
+	memory_site_t *head;
+
+	if (__atomic_exchange_n(&site->registered, 1, __ATOMIC_ACQ_REL))
+		return;
+	head = __atomic_load_n(&g_memory_sites, __ATOMIC_RELAXED);
+	do {
+		site->next = head;
+	} while (!__atomic_compare_exchange_n(&g_memory_sites, &head, site, true,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static void memory_account(memory_stats_t *stats, size_t size, bool alloc)
+{
+	size_t live, peak;
+
+	if (!alloc) {
+		__atomic_fetch_add(&stats->nr_frees, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&stats->live_bytes, size, __ATOMIC_RELAXED);
+		return;
+	}
+	__atomic_fetch_add(&stats->nr_allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats->total_bytes, size, __ATOMIC_RELAXED);
+	live = __atomic_add_fetch(&stats->live_bytes, size, __ATOMIC_RELAXED);
+	peak = __atomic_load_n(&stats->peak_bytes, __ATOMIC_RELAXED);
+	while (live > peak &&
+	       !__atomic_compare_exchange_n(&stats->peak_bytes, &peak, live, true,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static void *memory_track(void *base, size_t offset, size_t size,
+			  memory_site_t *site)
+{
+	uint8_t *p = (uint8_t *)base + offset;
+	struct memory_hdr *hdr = (struct memory_hdr *)(p - MEMORY_HDR_SIZE);
+
+	if (unlikely(!__atomic_load_n(&site->registered, __ATOMIC_ACQUIRE)))
+		memory_site_register(site);
+	hdr->site = site;
+	hdr->size = size;
+	hdr->offset = (uint32_t)offset;
+	hdr->magic = MEMORY_HDR_MAGIC;
+	memory_account(&g_memory_stats, size, true);
+	memory_account(&site->stats, size, true);
+	__atomic_fetch_add(&site->histogram[memory_bucket(size)], 1,
+			   __ATOMIC_RELAXED);
+	return p;
+}
+
+/* returns the start of the underlying allocation */
+static void *memory_untrack(struct memory_hdr *hdr)
+{
+	memory_account(&g_memory_stats, hdr->size, false);
+	memory_account(&hdr->site->stats, hdr->size, false);
+	hdr->magic = 0;
+	return (uint8_t *)hdr + MEMORY_HDR_SIZE - hdr->offset;
+}
+
+void safe_free(void *p)
+{
+	if (p != NULL) {
+		free(memory_untrack(memory_hdr(p)));
+	}
+}
+
+void *__safe_malloc(size_t size, memory_site_t *site)
+{
+	void *p;
+
+	p = malloc(MEMORY_HDR_SIZE + size);
+
+	if (p == NULL)
+		die_oom("malloc", 1, size);
+
+	return memory_track(p, MEMORY_HDR_SIZE, size, site);
+}
+
+void *__safe_calloc(size_t count, size_t size, memory_site_t *site)
+{
+	void *p = NULL;
+
+	if (size == 0 || count <= (SIZE_MAX - MEMORY_HDR_SIZE) / size)
+		p = calloc(1, MEMORY_HDR_SIZE + count * size);
+
+	if (p == NULL)
+		die_oom("calloc", count, size);
+
+	return memory_track(p, MEMORY_HDR_SIZE, count * size, site);
+}
+
+void *__safe_strdup(const char *s, memory_site_t *site)
+{
+	size_t len = strlen(s) + 1;
+
+	return memcpy(__safe_malloc(len, site), s, len);
+}
+
+void *__safe_realloc(void *data, size_t size, memory_site_t *site)
+{
+	void *p;
+	struct memory_hdr *hdr;
+
+	if (data == NULL)
+		return __safe_malloc(size, site);
+
+	hdr = memory_hdr(data);
+	if (hdr->offset != MEMORY_HDR_SIZE) {
+		/* aligned blocks can't go through realloc() */
+		p = __safe_malloc(size, site);
+		memcpy(p, data, MIN(size, hdr->size));
+		safe_free(data);
+		return p;
+	}
+
+	p = realloc(memory_untrack(hdr), MEMORY_HDR_SIZE + size);
+	if (p == NULL)
+		die_oom("realloc", 1, size);
+
+	return memory_track(p, MEMORY_HDR_SIZE, size, site);
+}
+
+void *__safe_realloc_zero(void *data, size_t old_size, size_t new_size,
+			  memory_site_t *site)
+{
+	void *p;
+
+	assert(old_size != new_size);
+
+	p = __safe_realloc(data, new_size, site);
+	if (new_size > old_size) {
+		memset((unsigned char *)p + old_size, 0, new_size - old_size);
+	}
+	return p;
+}
+
+void *__safe_aligned_alloc(size_t align, size_t size, memory_site_t *site)
+{
+	void *p;
+	size_t offset = MAX(align, MEMORY_HDR_SIZE);
+
+	if (posix_memalign(&p, align, offset + size))
+		die_oom("aligned_alloc", 1, size);
+
+	return memory_track(p, offset, size, site);
+}
+
+/**
+ * The function forms are kept so that the library exports the same symbols
+ * in both modes; the parentheses keep the macros from expanding here.
+ */
+void *(safe_malloc)(size_t size)
+{
+	return __safe_malloc(size, &g_memory_site_unknown);
+}
+
+void *(safe_calloc)(size_t count, size_t size)
+{
+	return __safe_calloc(count, size, &g_memory_site_unknown);
+}
+
+void *(safe_strdup)(const char *s)
+{
+	return __safe_strdup(s, &g_memory_site_unknown);
+}
+
+void *(safe_realloc)(void *data, size_t size)
+{
+	return __safe_realloc(data, size, &g_memory_site_unknown);
+}
+
+void *(safe_realloc_zero)(void *data, size_t old_size, size_t new_size)
+{
+	return __safe_realloc_zero(data, old_size, new_size,
+				   &g_memory_site_unknown);
+}
+
+void *(safe_aligned_alloc)(size_t align, size_t size)
+{
+	return __safe_aligned_alloc(align, size, &g_memory_site_unknown);
+}
+
+static void memory_stats_load(memory_stats_t *dst, memory_stats_t *src)
+{
+	dst->nr_allocs = __atomic_load_n(&src->nr_allocs, __ATOMIC_RELAXED);
+	dst->nr_frees = __atomic_load_n(&src->nr_frees, __ATOMIC_RELAXED);
+	dst->live_bytes = __atomic_load_n(&src->live_bytes, __ATOMIC_RELAXED);
+	dst->peak_bytes = __atomic_load_n(&src->peak_bytes, __ATOMIC_RELAXED);
+	dst->total_bytes = __atomic_load_n(&src->total_bytes, __ATOMIC_RELAXED);
+}
+
+int memory_stats_get(memory_stats_t *stats)
+{
+	memory_stats_load(stats, &g_memory_stats);
+	return 0;
+}
+
+void memory_stats_dump(FILE *fp)
+{
+	size_t i;
+	memory_stats_t st;
+	memory_site_t *site;
+
+	memory_stats_load(&st, &g_memory_stats);
+	fprintf(fp, "memory: allocs: %zu frees: %zu live: %zu peak: %zu "
+		"total: %zu\n", st.nr_allocs, st.nr_frees, st.live_bytes,
+		st.peak_bytes, st.total_bytes);
+
+	site = __atomic_load_n(&g_memory_sites, __ATOMIC_ACQUIRE);
+	for (; site != NULL; site = site->next) {
+		memory_stats_load(&st, &site->stats);
+		fprintf(fp, "  %s:%d allocs: %zu frees: %zu live: %zu "
+			"peak: %zu total: %zu hist:", site->file, site->line,
+			st.nr_allocs, st.nr_frees, st.live_bytes,
+			st.peak_bytes, st.total_bytes);
+		for (i = 0; i < MEMORY_STATS_NR_BUCKETS; i++) {
+			fprintf(fp, " %zu", __atomic_load_n(&site->histogram[i],
+							    __ATOMIC_RELAXED));
+		}
+		fprintf(fp, "\n");
+	}
+}
+
+#endif /* USE_MEMORY_STATS */
+
+#define HUGE_PAGE_MAX_NODES           256
+
+#ifdef __linux__
+static void huge_page_bind(void *p, size_t size, int node)
+{
+#if defined(SYS_mbind) && defined(MPOL_BIND)
+	unsigned long mask[HUGE_PAGE_MAX_NODES / (8 * sizeof(unsigned long))];
+	size_t bits = 8 * sizeof(unsigned long);
+
+	if (node < 0 || node >= HUGE_PAGE_MAX_NODES)
+		return;
+	memset(mask, 0, sizeof(mask));
+	mask[node / bits] |= 1UL << (node % bits);
+	/* the kernel drops the last bit of maxnode, hence the + 1 */
+	syscall(SYS_mbind, p, size, MPOL_BIND, mask, 8 * sizeof(mask) + 1, 0);
+#else
+	ARG_UNUSED(p);
+	ARG_UNUSED(size);
+	ARG_UNUSED(node);
+#endif
+}
+
+/**
+ * THP can only back huge page aligned ranges; map a huge page more than
+ * needed and trim the ends to get one.
+ */
+static void *huge_page_map_thp(size_t size)
+{
+	uint8_t *p, *aligned;
+	size_t head, tail;
+
+	p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		die_oom("mmap", 1, size);
+
+	aligned = (uint8_t *)ROUND_UP((uintptr_t)p, (uintptr_t)HUGE_PAGE_SIZE);
+	head = aligned - p;
+	tail = HUGE_PAGE_SIZE - head;
+	if (head)
+		munmap(p, head);
+	if (tail)
+		munmap(aligned + size, tail);
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+	return aligned;
+}
+#endif
+
+void *huge_page_alloc(size_t size, int numa_node)
+{
+	void *p;
+
+	size = ROUND_UP(size, (size_t)HUGE_PAGE_SIZE);
+#ifdef __linux__
+	p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if (p == MAP_FAILED)
+		p = huge_page_map_thp(size);
+	/* pages are not faulted in yet so they all land on numa_node */
+	huge_page_bind(p, size, numa_node);
+#else
+	ARG_UNUSED(numa_node);
+	p = safe_aligned_alloc(HUGE_PAGE_SIZE, size);
+	memset(p, 0, size);
+#endif
+	return p;
+}
+
+void huge_page_free(void *p, size_t size)
+{
+	if (p == NULL)
+		return;
+#ifdef __linux__
+	munmap(p, ROUND_UP(size, (size_t)HUGE_PAGE_SIZE));
+#else
+	ARG_UNUSED(size);
+	safe_free(p);
+#endif
+}
+
+struct arena_chunk_s {
+	arena_chunk_t *next;
+	size_t size;
+	size_t used;
+	unsigned char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+void arena_init(arena_t *arena, size_t chunk_size)
+{
+	arena->head = NULL;
+	arena->large = NULL;
+	arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+}
+
+static arena_chunk_t *arena_chunk_new(size_t size)
+{
+	arena_chunk_t *chunk;
+
+	chunk = safe_malloc(sizeof(arena_chunk_t) + size);
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+
+/* free chunks from `chunk` till `last` (not included) */
+static void arena_chunk_free(arena_chunk_t *chunk, arena_chunk_t *last)
+{
+	arena_chunk_t *next;
+
+	while (chunk != last) {
+		next = chunk->next;
+		safe_free(chunk);
+		chunk = next;
+	}
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+	arena_chunk_t *chunk = arena->head;
+
+	size = ROUND_UP(size, ARENA_ALIGN);
+	if (chunk != NULL && chunk->size - chunk->used >= size) {
+		chunk->used += size;
+		return chunk->data + chunk->used - size;
+	}
+
+	/**
+	 * Large requests get a chunk of their own on a separate list so that
+	 * the space left in the current chunk isn't given up for them.
+	 */
+	if (size > arena->chunk_size / 4) {
+		chunk = arena_chunk_new(size);
+		chunk->next = arena->large;
+		arena->large = chunk;
+	} else {
+		chunk = arena_chunk_new(arena->chunk_size);
+		chunk->next = arena->head;
+		arena->head = chunk;
+	}
+	chunk->used = size;
+	return chunk->data;
+}
+
+char *arena_strdup(arena_t *arena, const char *s)
+{
+	size_t len = strlen(s) + 1;
+
+	return memcpy(arena_alloc(arena, len), s, len);
+}
+
+void arena_free(arena_t *arena)
+{
+	arena_chunk_free(arena->head, NULL);
+	arena_chunk_free(arena->large, NULL);
+	arena->head = NULL;
+	arena->large = NULL;
+}
+
+arena_mark_t arena_mark(arena_t *arena)
+{
+	arena_mark_t mark = {
+		.head = arena->head,
+		.large = arena->large,
+		.used = arena->head ? arena->head->used : 0,
+	};
+
+	return mark;
+}
+
+void arena_rewind(arena_t *arena, arena_mark_t mark)
+{
+	arena_chunk_free(arena->head, mark.head);
+	arena_chunk_free(arena->large, mark.large);
+	arena->head = mark.head;
+	arena->large = mark.large;
+	if (mark.head != NULL)
+		mark.head->used = mark.used;
+}
+
+void arena_reset(arena_t *arena)
+{
+	arena_chunk_t *chunk = arena->head;
+
+	if (chunk == NULL) {
+		arena_free(arena);
+		return;
+	}
+	arena_chunk_free(chunk->next, NULL);
+	arena_chunk_free(arena->large, NULL);
+	chunk->next = NULL;
+	chunk->used = 0;
+	arena->large = NULL;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <utils/utils.h>
+#include <utils/mirror_ring.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+/* an anonymous, unlinked file to back the two mappings */
+static int mirror_ring_file(void)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+	return (int)syscall(SYS_memfd_create, "mirror_ring", MFD_CLOEXEC);
+#else
+	int fd;
+	char name[64];
+	static int seq;
+
+	snprintf(name, sizeof(name), "/mirror_ring-%d-%d", (int)getpid(),
+		 __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED));
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0)
+		shm_unlink(name);
+	return fd;
+#endif
+}
+
+int mirror_ring_init(mirror_ring_t *ring, size_t size)
+{
+	int fd;
+	uint8_t *p;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	if (size == 0)
+		return -1;
+	size = ROUND_UP(size, page);
+
+	fd = mirror_ring_file();
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, size) < 0)
+		goto error;
+
+	/* reserve 2 * size of address space, then put the file on both halves */
+	p = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		goto error;
+	if (mmap(p, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+		 fd, 0) == MAP_FAILED ||
+	    mmap(p + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+		 fd, 0) == MAP_FAILED) {
+		munmap(p, 2 * size);
+		goto error;
+	}
+	close(fd);
+
+	ring->buffer = p;
+	ring->size = size;
+	ring->tail = 0;
+	ring->used = 0;
+	return 0;
+error:
+	close(fd);
+	return -1;
+}
+
+void mirror_ring_destroy(mirror_ring_t *ring)
+{
+	if (ring->buffer)
+		munmap(ring->buffer, 2 * ring->size);
+	ring->buffer = NULL;
+	ring->size = 0;
+	ring->tail = 0;
+	ring->used = 0;
+}
+
+static inline uint8_t *mirror_ring_head(mirror_ring_t *ring)
+{
+	/* tail + used < 2 * size, which is still inside the mirror */
+	return ring->buffer + ring->tail + ring->used;
+}
+
+int mirror_ring_push(mirror_ring_t *ring, const void *data, size_t len)
+{
+	if (len > ring->size - ring->used)
+		return -1; // Out of space
+
+	memcpy(mirror_ring_head(ring), data, len);
+	ring->used += len;
+	return 0;
+}
+
+int mirror_ring_peek(mirror_ring_t *ring, void *data, size_t len)
+{
+	if (len > ring->used)
+		return -1; // Not enough data
+
+	if (data)
+		memcpy(data, ring->buffer + ring->tail, len);
+	return 0;
+}
+
+int mirror_ring_pop(mirror_ring_t *ring, void *data, size_t len)
+{
+	if (mirror_ring_peek(ring, data, len))
+		return -1;
+
+	ring->tail += len;
+	if (ring->tail >= ring->size)
+		ring->tail -= ring->size;
+	ring->used -= len;
+	return 0;
+}
+
+size_t mirror_ring_write_reserve(mirror_ring_t *ring, void **ptr)
+{
+	*ptr = mirror_ring_head(ring);
+	return ring->size - ring->used;
+}
+
+int mirror_ring_write_commit(mirror_ring_t *ring, size_t len)
+{
+	if (len > ring->size - ring->used)
+		return -1;
+
+	ring->used += len;
+	return 0;
+}
+
+size_t mirror_ring_read_reserve(mirror_ring_t *ring, void **ptr)
+{
+	*ptr = ring->buffer + ring->tail;
+	return ring->used;
+}
+
+int mirror_ring_read_commit(mirror_ring_t *ring, size_t len)
+{
+	return mirror_ring_pop(ring, NULL, len);
+}
+
+size_t mirror_ring_used(mirror_ring_t *ring)
+{
+	return ring->used;
+}
+
+size_t mirror_ring_free_space(mirror_ring_t *ring)
+{
+	return ring->size - ring->used;
+}
+
+void mirror_ring_flush(mirror_ring_t *ring)
+{
+	ring->tail = 0;
+	ring->used = 0;
+}
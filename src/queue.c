@@ -39,3 +39,49 @@ int queue_peek_first(queue_t *queue, queue_node_t **node)
 	*node = queue->list.head;
 	return 0;
 }
+
+void queue_mpsc_init(queue_mpsc_t *queue)
+{
+	queue->stub.next = NULL;
+	queue->head = &queue->stub;
+	queue->tail = &queue->stub;
+}
+
+void queue_mpsc_enqueue(queue_mpsc_t *queue, queue_node_t *node)
+{
+	queue_node_t *prev;
+
+	node->next = NULL;
+	prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+	__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+int queue_mpsc_dequeue(queue_mpsc_t *queue, queue_node_t **node)
+{
+	queue_node_t *tail = queue->tail;
+	queue_node_t *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+	/* skip over the stub */
+	if (tail == &queue->stub) {
+		if (next == NULL)
+			return -1;
+		queue->tail = next;
+		tail = next;
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	}
+
+	if (next == NULL) {
+		/* tail is the last node; a producer may be linking after it */
+		if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+			return -1;
+		/* put the stub behind it so that tail can be handed out */
+		queue_mpsc_enqueue(queue, &queue->stub);
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+		if (next == NULL)
+			return -1;
+	}
+
+	queue->tail = next;
+	*node = tail;
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <utils/utils.h>
+#include <utils/shard_map.h>
+
+#define SHARD_MAP_CACHE_LINE          64
+#define SHARD_MAP_SHARDS_PER_CPU      4
+#define SHARD_MAP_MAX_SHARDS          1024
+
+/* shards are cache line aligned so that locking one doesn't bounce another */
+struct shard_map_shard_s {
+	pthread_rwlock_t lock;
+	hash_map_t map;
+} __attribute__((aligned(SHARD_MAP_CACHE_LINE)));
+
+/**
+ * Fibonacci hashing: the multiply folds all bits of hash into the top ones
+ * which then pick the shard. This keeps the shard index independent of the
+ * low bits that the shard's map uses to pick a bucket.
+ */
+static inline shard_map_shard_t *shard_map_shard(shard_map_t *smap, hash_t hash)
+{
+	uint32_t h = hash * 0x9e3779b1U;
+
+	return smap->shards + (size_t)((uint64_t)h >> smap->shift);
+}
+
+static inline hash_t shard_map_hash(shard_map_t *smap, const void *key)
+{
+	return hash_map_hash(&smap->shards[0].map, key);
+}
+
+int shard_map_init(shard_map_t *smap, size_t nr_shards,
+		   const hash_map_config_t *config)
+{
+	size_t i;
+	long nr_cpus;
+	void *shards;
+	hash_map_config_t cfg = { 0 };
+
+	if (nr_shards == 0) {
+		nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nr_shards = SHARD_MAP_SHARDS_PER_CPU * (nr_cpus > 0 ? nr_cpus : 1);
+	}
+	nr_shards = MIN(nr_shards, (size_t)SHARD_MAP_MAX_SHARDS);
+	nr_shards = round_up_pow2((uint32_t)nr_shards);
+
+	if (posix_memalign(&shards, SHARD_MAP_CACHE_LINE,
+			   nr_shards * sizeof(shard_map_shard_t)))
+		return -1;
+	smap->shards = shards;
+	smap->nr_shards = nr_shards;
+	smap->shift = 32 - __builtin_ctz((unsigned int)nr_shards);
+
+	if (config != NULL)
+		cfg = *config;
+	for (i = 0; i < nr_shards; i++) {
+		if (hash_map_init_config(&smap->shards[i].map, &cfg))
+			goto error;
+		pthread_rwlock_init(&smap->shards[i].lock, NULL);
+		if (i == 0 && (cfg.flags & HASH_MAP_FLAG_RANDOM_SEED)) {
+			/* shard_map_hash() hashes with shard 0's seed */
+			cfg.flags &= ~HASH_MAP_FLAG_RANDOM_SEED;
+			cfg.hash_fn = smap->shards[0].map.hash_fn;
+			cfg.seed = smap->shards[0].map.seed;
+		}
+	}
+	return 0;
+error:
+	while (i--) {
+		pthread_rwlock_destroy(&smap->shards[i].lock);
+		hash_map_free(&smap->shards[i].map, NULL);
+	}
+	free(smap->shards);
+	smap->shards = NULL;
+	smap->nr_shards = 0;
+	return -1;
+}
+
+void shard_map_free(shard_map_t *smap, hash_map_callback_t cb)
+{
+	size_t i;
+
+	for (i = 0; i < smap->nr_shards; i++) {
+		pthread_rwlock_destroy(&smap->shards[i].lock);
+		hash_map_free(&smap->shards[i].map, cb);
+	}
+	free(smap->shards);
+	smap->shards = NULL;
+	smap->nr_shards = 0;
+}
+
+hash_t shard_map_insert(shard_map_t *smap, const void *key, void *val)
+{
+	hash_t hash;
+	shard_map_shard_t *shard;
+
+	hash = shard_map_hash(smap, key);
+	shard = shard_map_shard(smap, hash);
+	pthread_rwlock_wrlock(&shard->lock);
+	__hash_map_insert(&shard->map, key, hash, val);
+	pthread_rwlock_unlock(&shard->lock);
+	return hash;
+}
+
+int shard_map_add(shard_map_t *smap, const void *key, void *val)
+{
+	int rc = -1;
+	hash_t hash;
+	shard_map_shard_t *shard;
+
+	hash = shard_map_hash(smap, key);
+	shard = shard_map_shard(smap, hash);
+	pthread_rwlock_wrlock(&shard->lock);
+	if (__hash_map_get(&shard->map, key, hash) == NULL) {
+		__hash_map_insert(&shard->map, key, hash, val);
+		rc = 0;
+	}
+	pthread_rwlock_unlock(&shard->lock);
+	return rc;
+}
+
+void *shard_map_get(shard_map_t *smap, const void *key)
+{
+	void *val;
+	hash_t hash;
+	shard_map_shard_t *shard;
+
+	hash = shard_map_hash(smap, key);
+	shard = shard_map_shard(smap, hash);
+	pthread_rwlock_rdlock(&shard->lock);
+	val = __hash_map_get(&shard->map, key, hash);
+	pthread_rwlock_unlock(&shard->lock);
+	return val;
+}
+
+void *shard_map_delete(shard_map_t *smap, const void *key)
+{
+	void *val;
+	hash_t hash;
+	shard_map_shard_t *shard;
+
+	hash = shard_map_hash(smap, key);
+	shard = shard_map_shard(smap, hash);
+	pthread_rwlock_wrlock(&shard->lock);
+	val = __hash_map_delete(&shard->map, key, hash);
+	pthread_rwlock_unlock(&shard->lock);
+	return val;
+}
+
+size_t shard_map_count(shard_map_t *smap)
+{
+	size_t i, count = 0;
+
+	for (i = 0; i < smap->nr_shards; i++) {
+		pthread_rwlock_rdlock(&smap->shards[i].lock);
+		count += smap->shards[i].map.count;
+		pthread_rwlock_unlock(&smap->shards[i].lock);
+	}
+	return count;
+}
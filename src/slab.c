@@ -6,59 +6,168 @@
  */
 
 #include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #include <utils/slab.h>
 
+#define SLAB_CANARY 0xdeadbeaf
+#define SLAB_CANARY_PARKED 0xcafebabe
+#define SLAB_UNIT_NONE UINT32_MAX
+
+/*
+ * kept in a side array, slab->meta_size apart; `canary` is only set while
+ * the unit is leased (or parked in a slab_cache magazine)
+ */
 struct slab_unit {
-	uint32_t leased;
+	uint32_t next;
 	uint32_t canary;
-	uint8_t data[];
 };
 
-int slab_init(slab_t *slab, size_t slab_size,
-	      uint8_t *blob, size_t blob_size)
+static inline struct slab_unit *slab_unit(slab_t *slab, size_t i)
 {
-	slab->size = ROUND_UP(slab_size, sizeof(void *)) +
-		     sizeof(struct slab_unit);
+	return (struct slab_unit *)(slab->blob + i * slab->meta_size);
+}
+
+static size_t slab_data_offset(uint8_t *blob, size_t count, size_t meta,
+			       size_t align)
+{
+	uintptr_t p = (uintptr_t)blob + count * meta;
+
+	return ROUND_UP(p, (uintptr_t)align) - (uintptr_t)blob;
+}
+
+int slab_init_aligned(slab_t *slab, size_t slab_size, size_t align,
+		      uint8_t *blob, size_t blob_size)
+{
+	size_t i, count, head, meta, meta_align;
+
+	if (align & (align - 1))
+		return -1;
+	align = MAX(align, sizeof(void *));
+
+	/*
+	 * Units on their own cache lines may well be handed to different
+	 * threads; give their records a line each too, so that they don't
+	 * false-share through the side array either.
+	 */
+	meta = sizeof(struct slab_unit);
+	meta_align = sizeof(uint32_t);
+	if (align >= SLAB_CACHE_LINE_SIZE)
+		meta = meta_align = SLAB_CACHE_LINE_SIZE;
+
+	/* the side array is addressed in place, skip to an aligned start */
+	head = ROUND_UP((uintptr_t)blob, (uintptr_t)meta_align) - (uintptr_t)blob;
+	if (head >= blob_size)
+		return -1;
+	blob += head;
+	blob_size -= head;
 
-	if (slab->size > blob_size)
+	slab->size = ROUND_UP(MAX(slab_size, (size_t)1), align);
+	count = blob_size / (slab->size + meta);
+	count = MIN(count, (size_t)SLAB_UNIT_NONE - 1);
+	while (count > 0 && slab_data_offset(blob, count, meta, align) +
+	       count * slab->size > blob_size)
+		count--;
+	if (count == 0)
 		return -1;
 
-	slab->count = blob_size / slab->size;
 	memset(blob, 0, blob_size);
 	slab->blob = blob;
+	slab->meta_size = meta;
+	slab->data = blob + slab_data_offset(blob, count, meta, align);
+	slab->count = count;
+	slab->nr_free = count;
+	slab->free_head = 0;
+	for (i = 0; i < count; i++)
+		slab_unit(slab, i)->next = (i + 1 < count) ? i + 1 : SLAB_UNIT_NONE;
 
-	return (int)slab->count;
+	return (int)MIN(count, (size_t)INT32_MAX);
+}
+
+int slab_init(slab_t *slab, size_t slab_size,
+	      uint8_t *blob, size_t blob_size)
+{
+	return slab_init_aligned(slab, slab_size, sizeof(void *),
+				 blob, blob_size);
 }
 
 int slab_alloc(slab_t *slab, void **block)
 {
-	size_t i;
 	struct slab_unit *p;
+	uint32_t i = slab->free_head;
 
-	for (i = 0; i < slab->count; i++) {
-		p = (struct slab_unit *)(slab->blob + (i * slab->size));
-		if (!p->leased) {
-			p->leased = true;
-			p->canary = 0xdeadbeaf;
-			*block = p->data;
-			return 0;
-		}
-	}
-
-	return -1;
+	if (i == SLAB_UNIT_NONE)
+		return -1;
+
+	p = slab_unit(slab, i);
+	slab->free_head = p->next;
+	slab->nr_free -= 1;
+	__atomic_store_n(&p->canary, SLAB_CANARY, __ATOMIC_RELAXED);
+	*block = slab->data + (size_t)i * slab->size;
+	return 0;
+}
+
+/* the unit that `block` is the start of, or NULL */
+static struct slab_unit *slab_unit_of(slab_t *slab, void *block, size_t *index)
+{
+	size_t i, off;
+	uint8_t *data = block;
+
+	if (data < slab->data || data >= slab->data + slab->count * slab->size)
+		return NULL;
+
+	off = data - slab->data;
+	i = off / slab->size;
+	if (off != i * slab->size)
+		return NULL;
+
+	*index = i;
+	return slab_unit(slab, i);
+}
+
+static int slab_unit_mark(slab_t *slab, void *block, uint32_t from,
+			  uint32_t to, size_t *index)
+{
+	struct slab_unit *p = slab_unit_of(slab, block, index);
+
+	if (p == NULL)
+		return -1;
+
+	if (!__atomic_compare_exchange_n(&p->canary, &from, to, false,
+					 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return -1;
+	return 0;
 }
 
 int slab_free(slab_t *slab, void *block)
 {
-	ARG_UNUSED(slab);
-	struct slab_unit *p = CONTAINER_OF(block, struct slab_unit, data);
+	size_t i;
+	struct slab_unit *p = slab_unit_of(slab, block, &i);
 
-	if (p->canary != 0xdeadbeaf)
+	/* the slab itself isn't thread safe, no need for a CAS here */
+	if (p == NULL ||
+	    __atomic_load_n(&p->canary, __ATOMIC_RELAXED) != SLAB_CANARY)
 		return -1;
+	__atomic_store_n(&p->canary, 0, __ATOMIC_RELAXED);
 
-	p->leased = false;
+	p->next = slab->free_head;
+	slab->free_head = (uint32_t)i;
+	slab->nr_free += 1;
 
 	return 0;
 }
+
+int __slab_park(slab_t *slab, void *block)
+{
+	size_t i;
+
+	return slab_unit_mark(slab, block, SLAB_CANARY, SLAB_CANARY_PARKED, &i);
+}
+
+int __slab_unpark(slab_t *slab, void *block)
+{
+	size_t i;
+
+	return slab_unit_mark(slab, block, SLAB_CANARY_PARKED, SLAB_CANARY, &i);
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <utils/utils.h>
+#include <utils/memory.h>
+#include <utils/slab_cache.h>
+
+struct slab_magazine_s {
+	slab_magazine_t *next;
+	size_t count;
+	void *rounds[];
+};
+
+/* per-thread state; only the owner thread touches loaded/prev */
+struct slab_cache_cpu_s {
+	slab_cache_t *cache;
+	slab_magazine_t *loaded;
+	slab_magazine_t *prev;
+	slab_cache_cpu_t *next;
+};
+
+/*
+ * Debug builds mark blocks held in magazines as parked in the slab so a
+ * double free is caught. That is an atomic op on the slab's shared side
+ * array, so release builds only check that `block` is a unit of the slab
+ * and the fast path stays free of atomics.
+ */
+static inline int cache_block_park(slab_cache_t *cache, void *block)
+{
+#ifndef NDEBUG
+	return __slab_park(cache->slab, block);
+#else
+	uint8_t *p = block;
+	slab_t *slab = cache->slab;
+
+	if (p < slab->data || p >= slab->data + slab->count * slab->size ||
+	    (size_t)(p - slab->data) % slab->size != 0)
+		return -1;
+	return 0;
+#endif
+}
+
+static inline void cache_block_unpark(slab_cache_t *cache, void *block)
+{
+#ifndef NDEBUG
+	__slab_unpark(cache->slab, block);
+#else
+	ARG_UNUSED(cache);
+	ARG_UNUSED(block);
+#endif
+}
+
+static slab_magazine_t *magazine_new(slab_cache_t *cache)
+{
+	slab_magazine_t *mag;
+
+	mag = safe_malloc(sizeof(slab_magazine_t) +
+			  cache->magazine_size * sizeof(void *));
+	mag->next = NULL;
+	mag->count = 0;
+	return mag;
+}
+
+static void magazine_release(slab_cache_t *cache, slab_magazine_t *mag)
+{
+	void *block;
+
+	while (mag->count) {
+		block = mag->rounds[--mag->count];
+		cache_block_unpark(cache, block);
+		slab_free(cache->slab, block);
+	}
+	safe_free(mag);
+}
+
+/* Must be called with cache->lock held */
+static void depot_put(slab_cache_t *cache, slab_magazine_t *mag)
+{
+	slab_magazine_t **list;
+
+	list = mag->count ? &cache->full : &cache->empty;
+	mag->next = *list;
+	*list = mag;
+}
+
+/* Must be called with cache->lock held */
+static slab_magazine_t *depot_get(slab_magazine_t **list)
+{
+	slab_magazine_t *mag = *list;
+
+	if (mag != NULL)
+		*list = mag->next;
+	return mag;
+}
+
+/* Must be called with cache->lock held */
+static void cache_cpu_unlink(slab_cache_t *cache, slab_cache_cpu_t *cpu)
+{
+	slab_cache_cpu_t **p = &cache->threads;
+
+	while (*p != cpu)
+		p = &(*p)->next;
+	*p = cpu->next;
+}
+
+static void cache_cpu_destructor(void *arg)
+{
+	slab_cache_cpu_t *cpu = arg;
+	slab_cache_t *cache = cpu->cache;
+
+	pthread_mutex_lock(&cache->lock);
+	depot_put(cache, cpu->loaded);
+	depot_put(cache, cpu->prev);
+	cache_cpu_unlink(cache, cpu);
+	pthread_mutex_unlock(&cache->lock);
+	safe_free(cpu);
+}
+
+static slab_cache_cpu_t *cache_cpu_get(slab_cache_t *cache)
+{
+	slab_cache_cpu_t *cpu;
+
+	cpu = pthread_getspecific(cache->key);
+	if (likely(cpu != NULL))
+		return cpu;
+
+	cpu = safe_malloc(sizeof(slab_cache_cpu_t));
+	cpu->cache = cache;
+	cpu->loaded = magazine_new(cache);
+	cpu->prev = magazine_new(cache);
+	pthread_mutex_lock(&cache->lock);
+	cpu->next = cache->threads;
+	cache->threads = cpu;
+	pthread_mutex_unlock(&cache->lock);
+	pthread_setspecific(cache->key, cpu);
+	return cpu;
+}
+
+static inline void cache_cpu_swap(slab_cache_cpu_t *cpu)
+{
+	slab_magazine_t *tmp = cpu->loaded;
+
+	cpu->loaded = cpu->prev;
+	cpu->prev = tmp;
+}
+
+int slab_cache_init(slab_cache_t *cache, slab_t *slab, size_t magazine_size)
+{
+	if (pthread_key_create(&cache->key, cache_cpu_destructor))
+		return -1;
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->slab = slab;
+	cache->magazine_size = magazine_size ? magazine_size :
+					       SLAB_CACHE_MAGAZINE_SIZE;
+	cache->full = NULL;
+	cache->empty = NULL;
+	cache->threads = NULL;
+	return 0;
+}
+
+int slab_cache_alloc(slab_cache_t *cache, void **block)
+{
+	slab_magazine_t *mag;
+	slab_cache_cpu_t *cpu = cache_cpu_get(cache);
+
+	if (likely(cpu->loaded->count > 0))
+		goto out;
+
+	if (cpu->prev->count > 0) {
+		cache_cpu_swap(cpu);
+		goto out;
+	}
+
+	/* both magazines are empty; trade one for a full one from the depot */
+	pthread_mutex_lock(&cache->lock);
+	mag = depot_get(&cache->full);
+	if (mag != NULL) {
+		depot_put(cache, cpu->prev);
+		cpu->prev = cpu->loaded;
+		cpu->loaded = mag;
+	} else {
+		mag = cpu->loaded;
+		while (mag->count < cache->magazine_size &&
+		       slab_alloc(cache->slab, &mag->rounds[mag->count]) == 0)
+			cache_block_park(cache, mag->rounds[mag->count++]);
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	if (cpu->loaded->count == 0)
+		return -1;
+out:
+	*block = cpu->loaded->rounds[--cpu->loaded->count];
+	cache_block_unpark(cache, *block);
+	return 0;
+}
+
+int slab_cache_free(slab_cache_t *cache, void *block)
+{
+	slab_magazine_t *mag;
+	slab_cache_cpu_t *cpu;
+
+	if (cache_block_park(cache, block))
+		return -1;
+
+	cpu = cache_cpu_get(cache);
+	if (likely(cpu->loaded->count < cache->magazine_size))
+		goto out;
+
+	if (cpu->prev->count < cache->magazine_size) {
+		cache_cpu_swap(cpu);
+		goto out;
+	}
+
+	/* both magazines are full; trade one for an empty one from the depot */
+	pthread_mutex_lock(&cache->lock);
+	depot_put(cache, cpu->prev);
+	mag = depot_get(&cache->empty);
+	pthread_mutex_unlock(&cache->lock);
+	if (mag == NULL)
+		mag = magazine_new(cache);
+	cpu->prev = cpu->loaded;
+	cpu->loaded = mag;
+out:
+	cpu->loaded->rounds[cpu->loaded->count++] = block;
+	return 0;
+}
+
+void slab_cache_flush(slab_cache_t *cache)
+{
+	slab_cache_cpu_t *cpu;
+
+	cpu = pthread_getspecific(cache->key);
+	if (cpu == NULL)
+		return;
+	pthread_setspecific(cache->key, NULL);
+	cache_cpu_destructor(cpu);
+}
+
+void slab_cache_destroy(slab_cache_t *cache)
+{
+	slab_cache_cpu_t *cpu;
+	slab_magazine_t *mag;
+
+	while ((cpu = cache->threads) != NULL) {
+		cache->threads = cpu->next;
+		magazine_release(cache, cpu->loaded);
+		magazine_release(cache, cpu->prev);
+		safe_free(cpu);
+	}
+	while ((mag = depot_get(&cache->full)) != NULL)
+		magazine_release(cache, mag);
+	while ((mag = depot_get(&cache->empty)) != NULL)
+		magazine_release(cache, mag);
+	pthread_key_delete(cache->key);
+	pthread_mutex_destroy(&cache->lock);
+}
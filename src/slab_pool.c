@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026 Siddharth Chandrasekaran <sidcha.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <utils/utils.h>
+#include <utils/memory.h>
+#include <utils/slab_pool.h>
+
+#define SLAB_POOL_ALIGN               16
+#define SLAB_POOL_HDR_SIZE            sizeof(uintptr_t)
+#define SLAB_POOL_MIN_UNITS           8
+
+/* header tag for blocks that did not come from a slab; size is in the rest */
+#define SLAB_POOL_HDR_LARGE           0x1
+
+struct slab_pool_chunk_s {
+	slab_pool_chunk_t *next;
+	slab_pool_chunk_t *next_partial;
+	slab_t slab;
+	size_t class_size;
+	uint8_t *blob;
+};
+
+/**
+ * Slab units are SLAB_POOL_ALIGN aligned. A block starts SLAB_POOL_ALIGN
+ * bytes into its unit with our header right before it, the same layout as
+ * large blocks have within their allocation.
+ */
+#define CHUNK_HDR_SIZE ROUND_UP(sizeof(slab_pool_chunk_t), (size_t)SLAB_POOL_ALIGN)
+
+static inline uintptr_t *block_hdr(void *data)
+{
+	return (uintptr_t *)((uint8_t *)data - SLAB_POOL_HDR_SIZE);
+}
+
+static inline size_t class_index(size_t size)
+{
+	size_t n = (size ? size : 1) - 1;
+	int k;
+
+	if (n < 64)
+		return n / 16;
+	k = 63 - __builtin_clzll((unsigned long long)n);
+	return 4 + (k - 6) * 4 + ((n >> (k - 2)) & 3);
+}
+
+static inline size_t class_size(size_t ndx)
+{
+	size_t base;
+
+	if (ndx < 4)
+		return (ndx + 1) * 16;
+	base = (size_t)64 << ((ndx - 4) / 4);
+	return base + ((ndx - 4) % 4 + 1) * (base / 4);
+}
+
+static slab_pool_chunk_t *chunk_new(size_t ndx)
+{
+	size_t size, unit, blob_size;
+	slab_pool_chunk_t *chunk;
+
+	size = class_size(ndx);
+	unit = SLAB_POOL_ALIGN + size;
+	blob_size = MAX((size_t)SLAB_POOL_BLOB_SIZE, SLAB_POOL_MIN_UNITS * unit);
+	chunk = safe_aligned_alloc(SLAB_POOL_ALIGN, CHUNK_HDR_SIZE + blob_size);
+	chunk->blob = (uint8_t *)chunk + CHUNK_HDR_SIZE;
+	chunk->class_size = size;
+	chunk->next = NULL;
+	chunk->next_partial = NULL;
+	slab_init_aligned(&chunk->slab, unit, SLAB_POOL_ALIGN,
+			  chunk->blob, blob_size);
+	return chunk;
+}
+
+static void *large_alloc(size_t size)
+{
+	uint8_t *p;
+
+	p = safe_aligned_alloc(SLAB_POOL_ALIGN, SLAB_POOL_ALIGN + size);
+	p += SLAB_POOL_ALIGN;
+	*block_hdr(p) = (size << 1) | SLAB_POOL_HDR_LARGE;
+	return p;
+}
+
+void slab_pool_init(slab_pool_t *pool)
+{
+	memset(pool, 0, sizeof(slab_pool_t));
+}
+
+void slab_pool_destroy(slab_pool_t *pool)
+{
+	size_t i;
+	slab_pool_chunk_t *chunk, *next;
+
+	for (i = 0; i < SLAB_POOL_NR_CLASSES; i++) {
+		chunk = pool->classes[i].chunks;
+		while (chunk != NULL) {
+			next = chunk->next;
+			safe_free(chunk);
+			chunk = next;
+		}
+	}
+	memset(pool, 0, sizeof(slab_pool_t));
+}
+
+void *slab_pool_malloc(slab_pool_t *pool, size_t size)
+{
+	void *unit;
+	slab_pool_chunk_t *chunk;
+	slab_pool_class_t *cls;
+
+	if (size > SLAB_POOL_MAX_SIZE)
+		return large_alloc(size);
+
+	cls = &pool->classes[class_index(size)];
+	chunk = cls->partial;
+	if (chunk == NULL) {
+		chunk = chunk_new(class_index(size));
+		chunk->next = cls->chunks;
+		cls->chunks = chunk;
+		cls->partial = chunk;
+	}
+	slab_alloc(&chunk->slab, &unit);
+	if (chunk->slab.nr_free == 0)
+		cls->partial = chunk->next_partial;
+	unit = (uint8_t *)unit + SLAB_POOL_ALIGN;
+	*block_hdr(unit) = (uintptr_t)chunk;
+	return unit;
+}
+
+void *slab_pool_calloc(slab_pool_t *pool, size_t count, size_t size)
+{
+	void *p;
+
+	if (size && count > SIZE_MAX / size)
+		return safe_calloc(count, size); /* reports the overflow */
+	p = slab_pool_malloc(pool, count * size);
+	memset(p, 0, count * size);
+	return p;
+}
+
+size_t slab_pool_usable_size(void *data)
+{
+	uintptr_t hdr = *block_hdr(data);
+
+	if (hdr & SLAB_POOL_HDR_LARGE)
+		return hdr >> 1;
+	return ((slab_pool_chunk_t *)hdr)->class_size;
+}
+
+void *slab_pool_realloc(slab_pool_t *pool, void *data, size_t size)
+{
+	void *p;
+	size_t old_size;
+
+	if (data == NULL)
+		return slab_pool_malloc(pool, size);
+
+	old_size = slab_pool_usable_size(data);
+	/* stay put if the block is big enough and not grossly oversized */
+	if (size <= old_size && !(*block_hdr(data) & SLAB_POOL_HDR_LARGE) &&
+	    class_index(size) == class_index(old_size))
+		return data;
+
+	p = slab_pool_malloc(pool, size);
+	memcpy(p, data, MIN(size, old_size));
+	slab_pool_free(pool, data);
+	return p;
+}
+
+char *slab_pool_strdup(slab_pool_t *pool, const char *s)
+{
+	size_t len = strlen(s) + 1;
+
+	return memcpy(slab_pool_malloc(pool, len), s, len);
+}
+
+void slab_pool_free(slab_pool_t *pool, void *data)
+{
+	uintptr_t hdr;
+	slab_pool_chunk_t *chunk;
+	slab_pool_class_t *cls;
+
+	if (data == NULL)
+		return;
+
+	hdr = *block_hdr(data);
+	if (hdr & SLAB_POOL_HDR_LARGE) {
+		safe_free((uint8_t *)data - SLAB_POOL_ALIGN);
+		return;
+	}
+
+	chunk = (slab_pool_chunk_t *)hdr;
+	if (slab_free(&chunk->slab, (uint8_t *)data - SLAB_POOL_ALIGN) == 0 &&
+	    chunk->slab.nr_free == 1) {
+		/* was full, so it is not on the partial list */
+		cls = &pool->classes[class_index(chunk->class_size)];
+		chunk->next_partial = cls->partial;
+		cls->partial = chunk;
+	}
+}
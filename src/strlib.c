@@ -12,12 +12,13 @@
 #include <utils/strlib.h>
 #include <utils/memory.h>
 
-void string_create(string_t *s, const char *buf, size_t len)
+static void string_init(string_t *s, char *mem, uint32_t flags,
+			const char *buf, size_t len)
 {
-	s->buf = safe_malloc(sizeof(char) * (len + 1));
+	s->buf = mem;
 	s->len = 0;
 	s->max_len = len;
-	s->flags = STRING_ALLOCATED;
+	s->flags = flags;
 	if (buf != NULL) {
 		memcpy(s->buf, buf, len);
 		s->len = len;
@@ -25,6 +26,17 @@ void string_create(string_t *s, const char *buf, size_t len)
 	s->buf[len] = '\0'; /* Make sure there is always a terminating null */
 }
 
+void string_create(string_t *s, const char *buf, size_t len)
+{
+	string_init(s, safe_malloc(sizeof(char) * (len + 1)),
+		    STRING_ALLOCATED, buf, len);
+}
+
+void string_create_arena(arena_t *arena, string_t *s, const char *buf, size_t len)
+{
+	string_init(s, arena_alloc(arena, sizeof(char) * (len + 1)), 0, buf, len);
+}
+
 void string_clone(string_t *dest, const string_t *src)
 {
 	string_create(dest, src->buf, src->len);
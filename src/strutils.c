@@ -5,6 +5,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 
 #include <utils/strutils.h>
@@ -185,6 +186,32 @@ int split_string(char *buf, char *sep, char ***tokens)
 	return 0;
 }
 
+int split_string_arena(arena_t *arena, char *buf, char *sep, char ***tokens)
+{
+	char *tok, *rest, **toks, **new_toks;
+	size_t length = 0, size = 16;
+
+	toks = arena_alloc(arena, sizeof(char *) * size);
+	tok = strtok_r(buf, sep, &rest);
+	while (tok != NULL) {
+		if (length + 1 >= size) {
+			new_toks = arena_alloc(arena, sizeof(char *) * size * 4);
+			memcpy(new_toks, toks, sizeof(char *) * length);
+			toks = new_toks;
+			size *= 4;
+		}
+		toks[length] = arena_strdup(arena, tok);
+		length += 1;
+		tok = strtok_r(NULL, sep, &rest);
+	}
+	if (length == 0) {
+		return -1;
+	}
+	toks[length] = NULL;
+	*tokens = toks;
+	return 0;
+}
+
 int strcntchr(char *s, char c)
 {
 	int i = 0, count = 0;
@@ -245,6 +272,105 @@ uint64_t poly_hash(const char *str, int len)
 	return hash;
 }
 
+/* --- wyhash (public domain) by Wang Yi <godspeed_china@yeah.net> --- */
+
+static const uint64_t wyhash_secret[4] = {
+	0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+	0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+static inline void wy_mum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t)*a * *b;
+
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t wy_mix(uint64_t a, uint64_t b)
+{
+	wy_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t wy_r8(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t wy_r4(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t wy_r3(const uint8_t *p, size_t k)
+{
+	return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint64_t hash64_wy(const void *data, size_t len, uint64_t seed)
+{
+	const uint64_t *s = wyhash_secret;
+	const uint8_t *p = data;
+	uint64_t a, b, see1, see2;
+	size_t i = len;
+
+	seed ^= wy_mix(seed ^ s[0], s[1]);
+	if (len <= 16) {
+		if (len >= 4) {
+			a = (wy_r4(p) << 32) | wy_r4(p + ((len >> 3) << 2));
+			b = (wy_r4(p + len - 4) << 32) |
+			    wy_r4(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = wy_r3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		if (i > 48) {
+			see1 = see2 = seed;
+			do {
+				seed = wy_mix(wy_r8(p) ^ s[1], wy_r8(p + 8) ^ seed);
+				see1 = wy_mix(wy_r8(p + 16) ^ s[2], wy_r8(p + 24) ^ see1);
+				see2 = wy_mix(wy_r8(p + 32) ^ s[3], wy_r8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = wy_mix(wy_r8(p) ^ s[1], wy_r8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = wy_r8(p + i - 16);
+		b = wy_r8(p + i - 8);
+	}
+	a ^= s[1];
+	b ^= seed;
+	wy_mum(&a, &b);
+	return wy_mix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
 char *str_sep(char **str, const char *sep)
 {
 	char *start, *end;
@@ -24,7 +24,8 @@ static inline void wakeup_first_free_worker(workqueue_t *wq)
 
 	for (i = 0; i < wq->num_workers; i++) {
 		w = get_worker(wq, i);
-		if (w->state == WQ_WORKER_STATE_IDLE) {
+		if (__atomic_load_n(&w->state, __ATOMIC_SEQ_CST) ==
+		    WQ_WORKER_STATE_IDLE) {
 			event_set(&w->event);
 			break;
 		}
@@ -55,25 +56,25 @@ static inline work_t *get_backlog(workqueue_t *wq)
 	queue_node_t *node;
 
 	pthread_mutex_lock(&wq->backlog_lock);
-	if ((rc = queue_dequeue(&wq->backlog, &node)) == 0)
-		wq->backlog_count--;
+	rc = queue_mpsc_dequeue(&wq->backlog, &node);
 	pthread_mutex_unlock(&wq->backlog_lock);
 
 	if (rc != 0)
 		return NULL;
 
+	__atomic_fetch_sub(&wq->backlog_count, 1, __ATOMIC_RELAXED);
 	return CONTAINER_OF(node, work_t, node);
 }
 
 static inline void put_backlog(workqueue_t *wq, work_t *work)
 {
-	pthread_mutex_lock(&wq->backlog_lock);
-
 	// TODO: Make this a priority queue on work->slice
-	queue_enqueue(&wq->backlog, &work->node);
-	wq->backlog_count++;
-
-	pthread_mutex_unlock(&wq->backlog_lock);
+	queue_mpsc_enqueue(&wq->backlog, &work->node);
+	/*
+	 * Count only once the node is linked; an idle worker that sees the
+	 * count must be able to dequeue the work or it spins till we do.
+	 */
+	__atomic_fetch_add(&wq->backlog_count, 1, __ATOMIC_SEQ_CST);
 
 	wakeup_first_free_worker(wq);
 }
@@ -84,10 +85,10 @@ static inline void flush_backlog(workqueue_t *wq)
 	queue_node_t *node;
 
 	pthread_mutex_lock(&wq->backlog_lock);
-	while(queue_dequeue(&wq->backlog, &node) == 0) {
+	while(queue_mpsc_dequeue(&wq->backlog, &node) == 0) {
 		work = CONTAINER_OF(node, work_t, node);
 		work->status = WQ_WORK_COMPLETE;
-		wq->backlog_count--;
+		__atomic_fetch_sub(&wq->backlog_count, 1, __ATOMIC_RELAXED);
 	}
 	pthread_mutex_unlock(&wq->backlog_lock);
 }
@@ -99,10 +100,9 @@ static void *workqueue_factory(void *arg)
 	work_t *work;
 	workqueue_t *wq = w->wq;
 
-	w->state = WQ_WORKER_STATE_IDLE;
-
-	while (event_is_set(&w->event)) {
-		w->state = WQ_WORKER_STATE_RUNNING;
+	for (;;) {
+		__atomic_store_n(&w->state, WQ_WORKER_STATE_RUNNING,
+				 __ATOMIC_SEQ_CST);
 
 		while ((work = get_backlog(wq)) != NULL) {
 			if (work->requests & WQ_REQ_CANCEL_WORK)
@@ -117,7 +117,18 @@ static void *workqueue_factory(void *arg)
 				put_backlog(wq, work);
 		}
 
-		w->state = WQ_WORKER_STATE_IDLE;
+		/*
+		 * A put_backlog() that saw us running did not wake anyone up,
+		 * so look at the backlog once more after going idle. Either
+		 * we see its count or it sees us idle and sets our event.
+		 */
+		__atomic_store_n(&w->state, WQ_WORKER_STATE_IDLE,
+				 __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&wq->backlog_count, __ATOMIC_SEQ_CST) > 0)
+			continue;
+
+		if (!event_is_set(&w->event))
+			break;
 	}
 	return NULL;
 }
@@ -132,7 +143,7 @@ int workqueue_create(workqueue_t *wq, int num_workers)
 		return -1;
 
 	wq->backlog_count = 0;
-	queue_init(&wq->backlog);
+	queue_mpsc_init(&wq->backlog);
 	pthread_mutex_init(&wq->backlog_lock, NULL);
 
 	for (i = 0; i < num_workers; i++) {
@@ -160,7 +171,7 @@ int workqueue_add_work(workqueue_t *wq, work_t *work)
 
 int workqueue_backlog_count(workqueue_t *wq)
 {
-	return wq->backlog_count;
+	return __atomic_load_n(&wq->backlog_count, __ATOMIC_RELAXED);
 }
 
 void workqueue_destroy(workqueue_t *wq)
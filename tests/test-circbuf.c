@@ -7,8 +7,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <sched.h>
+#include <unistd.h>
 
+#include <utils/utils.h>
 #include <utils/circbuf.h>
+#include <utils/circbuf_mpmc.h>
+#include <utils/circbuf_wait.h>
+#include <utils/mirror_ring.h>
 
 #include "test.h"
 
@@ -19,6 +25,14 @@ struct test_struct
 };
 
 CIRCBUF_DEF(struct test_struct, test_cb, 10);
+CIRCBUF_SPSC_DEF(struct test_struct, test_spsc_cb, 10);
+CIRCBUF_MPMC_DEF(struct test_struct, test_mpmc_cb, 16);
+CIRCBUF_DEF(uint8_t, test_byte_cb, 13);
+CIRCBUF_DEF(uint32_t, test_pow2_cb, 64);
+CIRCBUF_DEF(uint32_t, test_npow2_cb, 63);
+CIRCBUF_WAIT_DEF(int, test_wait_cb, 8);
+
+int test_spsc_errors;
 
 int test_boundary()
 {
@@ -114,7 +128,7 @@ void *producer_thread(void *data)
 	while (!done) {
 		if ((r2() < W_PROB)) {
 			m.a = val;
-			if (CIRCBUF_PUSH(test_cb, &m) == 0) {
+			if (CIRCBUF_PUSH(test_spsc_cb, &m) == 0) {
 				val++;
 				if (val > LIMIT)
 					done = true;
@@ -132,10 +146,11 @@ void *consumer_thread(void *data)
 
 	while (!done) {
 		if (r2() < R_PROB) {
-			if (CIRCBUF_POP(test_cb, &m) == 0) {
+			if (CIRCBUF_POP(test_spsc_cb, &m) == 0) {
 				if (m.a != val) {
 					mod_printf("invalid data, got %d, expected %d", m.a, val);
-					continue;
+					test_spsc_errors++;
+					val = m.a;
 				}
 				val++;
 				if (m.a >= LIMIT)
@@ -150,7 +165,8 @@ int test_single_produce_single_consumer()
 {
 	pthread_t producer, consumer;
 
-	CIRCBUF_FLUSH(test_cb);
+	CIRCBUF_SPSC_FLUSH(test_spsc_cb);
+	test_spsc_errors = 0;
 
 	mod_printf("single produce single consumer test");
 
@@ -159,7 +175,347 @@ int test_single_produce_single_consumer()
 
 	pthread_join(producer, NULL);
 	pthread_join(consumer, NULL);
+
+	if (CIRCBUF_SPSC_FS(test_spsc_cb) != 10)
+		return -1;
+	return test_spsc_errors ? -1 : 0;
+}
+
+int test_bulk()
+{
+	int i, n, iter;
+	void *p;
+	uint8_t in[32], out[32], next_write = 0, next_read = 0;
+
+	CIRCBUF_FLUSH(test_byte_cb);
+	mod_printf("bulk and reserve/commit test");
+
+	/* chunk sizes that don't divide 13 move the wrap point around */
+	for (iter = 0; iter < 1000; iter++) {
+		for (i = 0; i < 32; i++)
+			in[i] = next_write + i;
+		n = CIRCBUF_PUSH_N(test_byte_cb, in, 1 + iter % 7);
+		next_write += n;
+
+		/* what a read(fd, p, n) into the ring would do */
+		n = CIRCBUF_WRITE_RESERVE(test_byte_cb, &p);
+		n = MIN(n, iter % 5);
+		for (i = 0; i < n; i++)
+			((uint8_t *)p)[i] = next_write++;
+		if (CIRCBUF_WRITE_COMMIT(test_byte_cb, n))
+			return -1;
+
+		n = CIRCBUF_POP_N(test_byte_cb, out, 1 + iter % 6);
+		for (i = 0; i < n; i++) {
+			if (out[i] != next_read++)
+				return -1;
+		}
+
+		n = CIRCBUF_READ_RESERVE(test_byte_cb, &p);
+		n = MIN(n, iter % 3);
+		for (i = 0; i < n; i++) {
+			if (((uint8_t *)p)[i] != next_read++)
+				return -1;
+		}
+		if (CIRCBUF_READ_COMMIT(test_byte_cb, n))
+			return -1;
+	}
+
+	/* drain; the ring must hold exactly what was not read */
+	n = CIRCBUF_POP_N(test_byte_cb, out, 32);
+	for (i = 0; i < n; i++) {
+		if (out[i] != next_read++)
+			return -1;
+	}
+	if (next_read != next_write || CIRCBUF_FS(test_byte_cb) != 13)
+		return -1;
+
+	/* over commit and bulk ops on full/empty ring */
+	if (CIRCBUF_WRITE_COMMIT(test_byte_cb, 14) == 0 ||
+	    CIRCBUF_READ_COMMIT(test_byte_cb, 1) == 0 ||
+	    CIRCBUF_POP_N(test_byte_cb, out, 1) != 0)
+		return -1;
+	if (CIRCBUF_PUSH_N(test_byte_cb, in, 32) != 13 ||
+	    CIRCBUF_PUSH_N(test_byte_cb, in, 1) != 0 ||
+	    CIRCBUF_WRITE_RESERVE(test_byte_cb, &p) != 0)
+		return -1;
+	return 0;
+}
+
+#define BENCH_ROUNDS 500000
+
+/* returns the time taken in usec, -1 if an element was lost on the way */
+static long bench_circbuf(int pow2)
+{
+	int i, j;
+	uint32_t v, sum = 0, expect = 0;
+	tick_t start = usec_now();
+
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		for (j = 0; j < 32; j++) {
+			v = i + j;
+			expect += v;
+			if (pow2)
+				CIRCBUF_PUSH(test_pow2_cb, &v);
+			else
+				CIRCBUF_PUSH(test_npow2_cb, &v);
+		}
+		for (j = 0; j < 32; j++) {
+			if (pow2)
+				CIRCBUF_POP(test_pow2_cb, &v);
+			else
+				CIRCBUF_POP(test_npow2_cb, &v);
+			sum += v;
+		}
+	}
+	/* using the sum keeps the pops from being optimized out */
+	return sum == expect ? (long)usec_since(start) : -1;
+}
+
+int bench_pow2()
+{
+	long t_pow2, t_npow2;
+
+	mod_printf("power of 2 size benchmark");
+
+	CIRCBUF_FLUSH(test_pow2_cb);
+	CIRCBUF_FLUSH(test_npow2_cb);
+	t_pow2 = bench_circbuf(1);
+	t_npow2 = bench_circbuf(0);
+	if (t_pow2 < 0 || t_npow2 < 0)
+		return -1;
+	mod_printf("%d push + pop: size 64 (mask): %ldms, size 63: %ldms",
+		   BENCH_ROUNDS * 32, t_pow2 / 1000, t_npow2 / 1000);
+	return 0;
+}
+
+int test_pow2()
+{
+	int i, n;
+	uint32_t v, next_read = 0, out[64];
+
+	mod_printf("power of 2 size test");
+
+	/* free running counts must survive wrapping around UINT_MAX */
+	test_pow2_cb.push_count = test_pow2_cb.pop_count = UINT32_MAX - 40;
+	for (v = 0; v < 64; v++) {
+		if (CIRCBUF_PUSH(test_pow2_cb, &v))
+			return -1;
+	}
+	if (CIRCBUF_PUSH(test_pow2_cb, &v) == 0 || CIRCBUF_FS(test_pow2_cb) != 0)
+		return -1;
+	for (i = 0; i < 32; i++) {
+		if (CIRCBUF_POP(test_pow2_cb, &v) || v != next_read++)
+			return -1;
+	}
+
+	/* out of line paths see the same counts */
+	for (v = 64; v < 96; v++) {
+		if (__circbuf_push(&test_pow2_cb, &v))
+			return -1;
+	}
+	n = CIRCBUF_POP_N(test_pow2_cb, out, 64);
+	if (n != 64 || CIRCBUF_FS(test_pow2_cb) != 64)
+		return -1;
+	for (i = 0; i < n; i++) {
+		if (out[i] != next_read++)
+			return -1;
+	}
+	CIRCBUF_FLUSH(test_pow2_cb);
+	return 0;
+}
+
+int test_mirror_ring()
+{
+	int i, rc = -1;
+	uint8_t *p, rec[256], next_write = 0, next_read = 0;
+	size_t n, len, off;
+	mirror_ring_t ring;
+
+	mod_printf("mirror ring test");
+
+	if (mirror_ring_init(&ring, 1000))
+		return -1;
+	if (ring.size < 1000 || mirror_ring_free_space(&ring) != ring.size)
+		goto out;
+
+	/* both halves are the same memory */
+	ring.buffer[3] = 0x5a;
+	if (ring.buffer[ring.size + 3] != 0x5a)
+		goto out;
+
+	/*
+	 * Length prefixed records of odd sizes so they keep straddling the
+	 * wrap point; parse them in place, never copying out.
+	 */
+	for (i = 0; i < 10000; i++) {
+		len = 1 + (i * 37) % (sizeof(rec) - 1);
+		rec[0] = (uint8_t)len;
+		for (off = 1; off < len; off++)
+			rec[off] = next_write++;
+		if (mirror_ring_push(&ring, rec, len)) {
+			next_write -= len - 1;
+			if (len <= mirror_ring_free_space(&ring))
+				goto out;
+		}
+
+		n = mirror_ring_read_reserve(&ring, (void **)&p);
+		while (n > 0 && p[0] <= n) {
+			for (off = 1; off < p[0]; off++) {
+				if (p[off] != next_read++)
+					goto out;
+			}
+			len = p[0];
+			if (mirror_ring_read_commit(&ring, len))
+				goto out;
+			n -= len;
+			p += len;
+			if (i % 3)
+				break;
+		}
+	}
+
+	/* all or nothing push/pop */
+	mirror_ring_flush(&ring);
+	if (mirror_ring_write_reserve(&ring, (void **)&p) != ring.size ||
+	    mirror_ring_write_commit(&ring, ring.size) ||
+	    mirror_ring_push(&ring, rec, 1) == 0 ||
+	    mirror_ring_pop(&ring, NULL, ring.size - 1) ||
+	    mirror_ring_peek(&ring, rec, 2) == 0 ||
+	    mirror_ring_pop(&ring, rec, 1) ||
+	    mirror_ring_used(&ring) != 0)
+		goto out;
+	rc = 0;
+out:
+	mirror_ring_destroy(&ring);
+	return rc;
+}
+
+int test_wait_errors;
+
+void *wait_producer_thread(void *data)
+{
+	int i;
+
+	(void)data;
+	for (i = 0; i < LIMIT; i++) {
+		if (CIRCBUF_PUSH_WAIT(test_wait_cb, &i, -1))
+			test_wait_errors++;
+		/* let the consumer drain and go to sleep now and then */
+		if (i % 10000 == 0)
+			usleep(1000);
+	}
+	return NULL;
+}
+
+int test_waitable()
+{
+	int i, v;
+	tick_t start;
+	pthread_t producer;
+
+	mod_printf("waitable test");
+
+	if (CIRCBUF_WAIT_INIT(test_wait_cb))
+		return -1;
+	test_wait_errors = 0;
+
+	/* empty: times out after roughly the given time */
+	start = millis_now();
+	if (CIRCBUF_POP_WAIT(test_wait_cb, &v, 20) == 0 ||
+	    millis_since(start) < 20)
+		goto error;
+
+	pthread_create(&producer, NULL, wait_producer_thread, NULL);
+	for (i = 0; i < LIMIT; i++) {
+		if (CIRCBUF_POP_WAIT(test_wait_cb, &v, -1) || v != i) {
+			test_wait_errors++;
+			break;
+		}
+	}
+	pthread_join(producer, NULL);
+	if (test_wait_errors || CIRCBUF_SPSC_FS(test_wait_cb) != 8)
+		goto error;
+
+	/* full: push times out, a pop from another thread would free it */
+	for (i = 0; i < 8; i++)
+		CIRCBUF_PUSH(test_wait_cb, &i);
+	if (CIRCBUF_PUSH_WAIT(test_wait_cb, &i, 10) == 0 ||
+	    CIRCBUF_POP(test_wait_cb, &v) || v != 0 ||
+	    CIRCBUF_PUSH_WAIT(test_wait_cb, &i, 10))
+		goto error;
+
+	CIRCBUF_SPSC_FLUSH(test_wait_cb);
+	CIRCBUF_WAIT_CLEANUP(test_wait_cb);
 	return 0;
+error:
+	CIRCBUF_WAIT_CLEANUP(test_wait_cb);
+	return -1;
+}
+
+#define MPMC_THREADS 4
+#define MPMC_LIMIT (LIMIT / MPMC_THREADS)
+
+int test_mpmc_popped;
+int test_mpmc_errors;
+
+void *mpmc_producer_thread(void *data)
+{
+	struct test_struct m = { .b = (char)(intptr_t)data };
+
+	for (m.a = 0; m.a < MPMC_LIMIT; m.a++) {
+		while (CIRCBUF_PUSH(test_mpmc_cb, &m))
+			sched_yield();
+	}
+	return NULL;
+}
+
+void *mpmc_consumer_thread(void *data)
+{
+	int last[MPMC_THREADS] = { -1, -1, -1, -1 };
+	struct test_struct m;
+
+	(void)data;
+	while (__atomic_load_n(&test_mpmc_popped, __ATOMIC_RELAXED) <
+	       MPMC_LIMIT * MPMC_THREADS) {
+		if (CIRCBUF_POP(test_mpmc_cb, &m)) {
+			sched_yield();
+			continue;
+		}
+		__atomic_fetch_add(&test_mpmc_popped, 1, __ATOMIC_RELAXED);
+		/* FIFO: a consumer sees each producer's items in order */
+		if (m.b < 0 || m.b >= MPMC_THREADS || m.a <= last[(int)m.b])
+			__atomic_fetch_add(&test_mpmc_errors, 1, __ATOMIC_RELAXED);
+		else
+			last[(int)m.b] = m.a;
+	}
+	return NULL;
+}
+
+int test_multi_produce_multi_consumer()
+{
+	intptr_t i;
+	pthread_t producers[MPMC_THREADS], consumers[MPMC_THREADS];
+
+	CIRCBUF_MPMC_FLUSH(test_mpmc_cb);
+	test_mpmc_popped = 0;
+	test_mpmc_errors = 0;
+
+	mod_printf("multi produce multi consumer test");
+
+	for (i = 0; i < MPMC_THREADS; i++) {
+		pthread_create(&producers[i], NULL, mpmc_producer_thread, (void *)i);
+		pthread_create(&consumers[i], NULL, mpmc_consumer_thread, NULL);
+	}
+	for (i = 0; i < MPMC_THREADS; i++) {
+		pthread_join(producers[i], NULL);
+		pthread_join(consumers[i], NULL);
+	}
+
+	if (test_mpmc_popped != MPMC_LIMIT * MPMC_THREADS ||
+	    CIRCBUF_MPMC_FS(test_mpmc_cb) != 16)
+		return -1;
+	return test_mpmc_errors ? -1 : 0;
 }
 
 TEST_DEF(circular_buffer)
@@ -168,7 +524,15 @@ TEST_DEF(circular_buffer)
 
 	TEST_MOD_EXEC(test_boundary());
 	TEST_MOD_EXEC(test_probabilistic());
+	TEST_MOD_EXEC(test_bulk());
+	TEST_MOD_EXEC(test_pow2());
+	if (ctx->bench) {
+		TEST_MOD_EXEC(bench_pow2());
+	}
+	TEST_MOD_EXEC(test_mirror_ring());
 	TEST_MOD_EXEC(test_single_produce_single_consumer());
+	TEST_MOD_EXEC(test_multi_produce_multi_consumer());
+	TEST_MOD_EXEC(test_waitable());
 
 	TEST_MOD_REPORT();
 }
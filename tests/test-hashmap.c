@@ -1,5 +1,7 @@
 #include <string.h>
+#include <pthread.h>
 #include <utils/hashmap.h>
+#include <utils/shard_map.h>
 #include <utils/memory.h>
 #include <utils/strutils.h>
 
@@ -89,6 +91,217 @@ int test_dict_delete(hash_map_t *map, const char * const *words, size_t count)
 	return not_found * -1;
 }
 
+int test_dict_lookup(hash_map_t *map, const char * const *words, size_t count)
+{
+	size_t ndx, misses = 0, false_hits = 0;
+	struct test_hashmap *p;
+	char miss[64];
+
+	for (ndx = 0; ndx < count; ndx++) {
+		p = hash_map_get(map, words[ndx], 0);
+		if (p == NULL || p->off != ndx)
+			misses += 1;
+		snprintf(miss, sizeof(miss), "%s#", words[ndx]);
+		if (hash_map_get(map, miss, 0) != NULL)
+			false_hits += 1;
+	}
+	if (misses || false_hits) {
+		mod_printf("Err: lookup misses: %zu false hits: %zu",
+			   misses, false_hits);
+		return -1;
+	}
+	mod_printf("Looked up %zu items", count);
+	return 0;
+}
+
+/* insert_many all words, then get_many them along with as many misses */
+int test_dict_batch(enum hash_map_type type, const char * const *words,
+		    size_t count)
+{
+	int rc = 0;
+	size_t ndx, found;
+	hash_map_t map;
+	hash_map_config_t config = { .type = type };
+	const void **keys;
+	void **vals;
+	char (*miss)[64];
+
+	keys = safe_malloc(2 * count * sizeof(void *));
+	vals = safe_malloc(2 * count * sizeof(void *));
+	miss = safe_malloc(count * sizeof(*miss));
+	for (ndx = 0; ndx < count; ndx++) {
+		keys[ndx] = words[ndx];
+		vals[ndx] = new_test_hashmap_value(ndx, words[ndx]);
+		snprintf(miss[ndx], sizeof(miss[ndx]), "%s#", words[ndx]);
+		keys[count + ndx] = miss[ndx];
+	}
+	hash_map_init_config(&map, &config);
+	hash_map_insert_many(&map, keys, vals, count);
+	memset(vals, 0, 2 * count * sizeof(void *));
+	found = hash_map_get_many(&map, keys, vals, 2 * count);
+	for (ndx = 0; ndx < 2 * count; ndx++) {
+		if (ndx < count && (vals[ndx] == NULL ||
+		    ((struct test_hashmap *)vals[ndx])->off != ndx))
+			rc = -1;
+		if (ndx >= count && vals[ndx] != NULL)
+			rc = -1;
+	}
+	if (found != count || map.count != count)
+		rc = -1;
+	mod_printf("Batch insert/lookup of %zu keys, found %zu", count, found);
+	hash_map_free(&map, free_test_hashmap_value);
+	safe_free(keys);
+	safe_free(vals);
+	safe_free(miss);
+	return rc;
+}
+
+/**
+ * A map sized for all words must not grow while they are inserted. Once
+ * all but `keep` are deleted, it must give the memory back; on the delete
+ * path when `shrink_factor` is set, else on hash_map_compact().
+ */
+int test_dict_sizing(enum hash_map_type type, uint32_t flags,
+		     double shrink_factor, const char * const *words,
+		     size_t count)
+{
+	int rc = 0;
+	size_t ndx, keep = 10, capacity;
+	hash_map_t map;
+	hash_map_config_t config = {
+		.type = type, .flags = flags, .capacity = count,
+		.shrink_factor = shrink_factor,
+	};
+
+	if (hash_map_init_config(&map, &config))
+		return -1;
+	capacity = map.capacity;
+	test_dict_insert(&map, words, count);
+	if (map.capacity != capacity) {
+		mod_printf("Err: presized map grew %zu -> %zu", capacity,
+			   map.capacity);
+		rc = -1;
+	}
+	for (ndx = keep; ndx < count; ndx++)
+		free_test_hashmap_value(NULL, hash_map_delete(&map, words[ndx], 0));
+	if (shrink_factor == 0) {
+		if (map.capacity != capacity)
+			rc = -1;
+		hash_map_compact(&map);
+	}
+	if (map.capacity >= capacity / 64)
+		rc = -1;
+	for (ndx = 0; ndx < keep; ndx++) {
+		if (hash_map_get(&map, words[ndx], 0) == NULL)
+			rc = -1;
+	}
+	mod_printf("Sized for %zu items: capacity %zu -> %zu", count, capacity,
+		   map.capacity);
+	hash_map_free(&map, free_test_hashmap_value);
+	return rc;
+}
+
+/**
+ * Right after a shrink, a few inserts must not grow the map back and a few
+ * more deletes must not shrink it again; each of those is a full rebuild.
+ */
+int test_shrink_boundary(enum hash_map_type type, uint32_t flags,
+			 const char * const *words, size_t count)
+{
+	int rc = 0;
+	size_t ndx, i, k, capacity, changes = 0;
+	hash_map_t map;
+	hash_map_config_t config = {
+		.type = type, .flags = flags, .shrink_factor = 0.2,
+	};
+
+	/* a shrunk map would sit right on this one */
+	config.shrink_factor = 0.4;
+	if (hash_map_init_config(&map, &config) == 0) {
+		hash_map_free(&map, NULL);
+		return -1;
+	}
+	config.shrink_factor = 0.2;
+	if (hash_map_init_config(&map, &config))
+		return -1;
+
+	count = MIN(count, (size_t)4096);
+	test_dict_insert(&map, words, count);
+	capacity = map.capacity;
+	for (ndx = count; ndx > 0 && map.capacity == capacity; ndx--)
+		free_test_hashmap_value(NULL,
+			hash_map_delete(&map, words[ndx - 1], 0));
+	if (map.capacity == capacity)
+		rc = -1;
+
+	/* words[ndx..] are out; go back and forth around the boundary */
+	capacity = map.capacity;
+	for (i = 0; i < 1000; i++) {
+		for (k = ndx; k < ndx + 2; k++)
+			hash_map_insert(&map, words[k],
+					new_test_hashmap_value(k, words[k]));
+		changes += map.capacity != capacity;
+		for (k = ndx - 2; k < ndx + 2; k++)
+			free_test_hashmap_value(NULL,
+				hash_map_delete(&map, words[k], 0));
+		changes += map.capacity != capacity;
+		for (k = ndx - 2; k < ndx; k++)
+			hash_map_insert(&map, words[k],
+					new_test_hashmap_value(k, words[k]));
+	}
+	mod_printf("Shrunk to %zu at %zu items, resized %zu times after",
+		   capacity, map.count, changes);
+	if (changes)
+		rc = -1;
+	hash_map_free(&map, free_test_hashmap_value);
+	return rc;
+}
+
+/* iterate in insertion order while deleting every other item on the way */
+int test_ordered(const char * const *words, size_t count)
+{
+	int rc = 0;
+	size_t ndx, expect = 0, seen = 0;
+	hash_map_t map;
+	hash_map_config_t config = { .type = HASH_MAP_TYPE_ORDERED };
+	hash_map_iterator_t it2;
+	struct test_hashmap *val;
+	char *key;
+
+	hash_map_init_config(&map, &config);
+	test_dict_insert(&map, words, count);
+	HASH_MAP_FOREACH(&map, &key, &val) {
+		if (val->off != expect)
+			rc = -1;
+		if (expect % 2 == 0)
+			free_test_hashmap_value(NULL,
+				hash_map_delete(&map, words[expect], 0));
+		expect++;
+	}
+	if (expect != count || map.count != count / 2)
+		rc = -1;
+
+	hash_map_compact(&map);
+	for (ndx = 1; ndx < count; ndx += 2) {
+		if (hash_map_get(&map, words[ndx], 0) == NULL)
+			rc = -1;
+	}
+	expect = 1;
+	hash_map_it_init(&it2, &map);
+	while (hash_map_it_next(&it2, &key, (void **)&val) == 0) {
+		if (val->off != expect)
+			rc = -1;
+		expect += 2;
+		seen++;
+	}
+	mod_printf("Ordered map: deleted %zu while iterating, %zu in order",
+		   count - map.count, seen);
+	if (seen != count / 2)
+		rc = -1;
+	hash_map_free(&map, free_test_hashmap_value);
+	return rc;
+}
+
 size_t test_build_word_list(char *buf, const char *const **word_list)
 {
 	size_t count, ndx = 0;
@@ -107,12 +320,284 @@ size_t test_build_word_list(char *buf, const char *const **word_list)
 	return count;
 }
 
+int test_dict(hash_map_t *map, const char * const *words, size_t count)
+{
+	if (test_dict_insert(map, words, count))
+		return -1;
+	if (test_dict_iterator(map, words, count))
+		return -1;
+	if (test_dict_lookup(map, words, count))
+		return -1;
+	if (test_dict_delete(map, words, count))
+		return -1;
+	if (map->count)
+		return -1;
+	return test_dict_insert(map, words, count);
+}
+
+int test_dict_migrating(hash_map_t *map, const char * const *words, size_t count)
+{
+	size_t ndx = 0;
+
+	/* stop inserting halfway through moving the buckets of a big rehash */
+	while (ndx < count && (map->old_capacity < 4096 ||
+	       map->migrate_pos < map->old_capacity / 2)) {
+		hash_map_insert(map, words[ndx],
+				new_test_hashmap_value(ndx, words[ndx]));
+		ndx++;
+	}
+	if (map->old_pool == NULL)
+		return -1;
+	mod_printf("Rehash in progress after %zu items", ndx);
+	if (test_dict_iterator(map, words, ndx) ||
+	    test_dict_lookup(map, words, ndx) ||
+	    test_dict_delete(map, words, ndx))
+		return -1;
+	return map->count ? -1 : 0;
+}
+
+#define TEST_NUM_KEYS 50000
+
+void noop_test_hashmap_value(const char *key, void *val)
+{
+	ARG_UNUSED(key);
+	ARG_UNUSED(val);
+}
+
+int test_u64_keys(enum hash_map_type type)
+{
+	uint64_t i, *key;
+	size_t found = 0;
+	void *val;
+	hash_map_t map;
+	hash_map_config_t config = {
+		.type = type,
+		.key_type = HASH_MAP_KEY_U64,
+	};
+
+	if (hash_map_init_config(&map, &config))
+		return -1;
+
+	/* use the keys themselves as values */
+	for (i = 0; i < TEST_NUM_KEYS; i++)
+		hash_map_insert_u64(&map, i << 32 | i, (void *)(uintptr_t)i);
+	for (i = 0; i < TEST_NUM_KEYS; i++) {
+		if (hash_map_get_u64(&map, i << 32 | i) != (void *)(uintptr_t)i ||
+		    hash_map_get_u64(&map, i << 33 | 1) != NULL)
+			return -1;
+	}
+	HASH_MAP_FOREACH(&map, (char **)&key, &val) {
+		if (*key != ((uint64_t)(uintptr_t)val << 32 | (uintptr_t)val))
+			return -1;
+		found++;
+	}
+	for (i = 0; i < TEST_NUM_KEYS; i += 2)
+		hash_map_delete_u64(&map, i << 32 | i);
+	if (found != TEST_NUM_KEYS || map.count != TEST_NUM_KEYS / 2 ||
+	    hash_map_get_u64(&map, 1ull << 32 | 1) != (void *)1)
+		return -1;
+	hash_map_free(&map, noop_test_hashmap_value);
+	mod_printf("u64 keys ok");
+	return 0;
+}
+
+int test_binary_keys(enum hash_map_type type)
+{
+	size_t i;
+	uint8_t key[16] = { 0 };
+	hash_map_t map;
+	hash_map_config_t config = {
+		.type = type,
+		.key_type = HASH_MAP_KEY_BINARY,
+		.key_len = sizeof(key),
+	};
+
+	if (hash_map_init_config(&map, &config))
+		return -1;
+
+	/* keys differ only after an embedded NUL byte */
+	for (i = 0; i < TEST_NUM_KEYS; i++) {
+		memcpy(key + 8, &i, sizeof(i));
+		hash_map_insert(&map, key, (void *)(i + 1));
+	}
+	for (i = 0; i < TEST_NUM_KEYS; i++) {
+		memcpy(key + 8, &i, sizeof(i));
+		if (hash_map_get(&map, key, 0) != (void *)(i + 1))
+			return -1;
+	}
+	for (i = 0; i < TEST_NUM_KEYS; i++) {
+		memcpy(key + 8, &i, sizeof(i));
+		if (hash_map_delete(&map, key, 0) != (void *)(i + 1))
+			return -1;
+	}
+	if (map.count != 0)
+		return -1;
+	hash_map_free(&map, noop_test_hashmap_value);
+	mod_printf("binary keys ok");
+	return 0;
+}
+
+#define TEST_SHARD_MAP_THREADS 4
+
+struct test_shard_map_ctx {
+	shard_map_t *smap;
+	const char * const *words;
+	size_t count;
+	size_t id;
+	size_t errors;
+};
+
+/* thread `id` owns words[id], words[id + nr_threads], ... */
+void *test_shard_map_thread(void *arg)
+{
+	size_t ndx;
+	struct test_hashmap *p;
+	struct test_shard_map_ctx *ctx = arg;
+
+	for (ndx = ctx->id; ndx < ctx->count; ndx += TEST_SHARD_MAP_THREADS) {
+		p = new_test_hashmap_value(ndx, ctx->words[ndx]);
+		shard_map_insert(ctx->smap, p->key, p);
+	}
+	for (ndx = 0; ndx < ctx->count; ndx++) {
+		p = shard_map_get(ctx->smap, ctx->words[ndx]);
+		if (ndx % TEST_SHARD_MAP_THREADS != ctx->id)
+			continue;
+		if (p == NULL || p->off != ndx)
+			ctx->errors++;
+	}
+	/* delete every other word owned by this thread */
+	for (ndx = ctx->id; ndx < ctx->count;
+	     ndx += 2 * TEST_SHARD_MAP_THREADS) {
+		p = shard_map_delete(ctx->smap, ctx->words[ndx]);
+		if (p == NULL || p->off != ndx)
+			ctx->errors++;
+		else
+			free_test_hashmap_value(NULL, p);
+	}
+	return NULL;
+}
+
+int test_shard_map(const char * const *words, size_t count)
+{
+	size_t i, errors = 0, expected = 0;
+	shard_map_t smap;
+	hash_map_config_t config = { .type = HASH_MAP_TYPE_OPEN,
+				     .flags = HASH_MAP_FLAG_RANDOM_SEED };
+	pthread_t threads[TEST_SHARD_MAP_THREADS];
+	struct test_shard_map_ctx ctx[TEST_SHARD_MAP_THREADS];
+
+	if (shard_map_init(&smap, 0, &config))
+		return -1;
+	for (i = 0; i < TEST_SHARD_MAP_THREADS; i++) {
+		ctx[i] = (struct test_shard_map_ctx){
+			.smap = &smap, .words = words,
+			.count = count, .id = i,
+		};
+		pthread_create(&threads[i], NULL, test_shard_map_thread, &ctx[i]);
+	}
+	for (i = 0; i < TEST_SHARD_MAP_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+		errors += ctx[i].errors;
+	}
+	for (i = 0; i < count; i++) {
+		if ((i / TEST_SHARD_MAP_THREADS) % 2)
+			expected++;
+	}
+	if (errors || shard_map_count(&smap) != expected) {
+		mod_printf("Err: errors: %zu count: %zu/%zu", errors,
+			   shard_map_count(&smap), expected);
+		shard_map_free(&smap, free_test_hashmap_value);
+		return -1;
+	}
+	/* words[TEST_SHARD_MAP_THREADS] was not deleted */
+	if (shard_map_add(&smap, words[TEST_SHARD_MAP_THREADS], NULL) == 0)
+		errors++;
+	if (shard_map_add(&smap, words[0], new_test_hashmap_value(0, words[0])))
+		errors++;
+	shard_map_free(&smap, free_test_hashmap_value);
+	mod_printf("Sharded map with %d threads: %zu items", TEST_SHARD_MAP_THREADS,
+		   expected);
+	return errors ? -1 : 0;
+}
+
+#define TEST_READ_MOSTLY_READERS 3
+
+struct test_read_mostly_ctx {
+	hash_map_t *map;
+	const char * const *words;
+	size_t count;
+	int done;
+	size_t lookups;
+	size_t errors;
+};
+
+/* words[0 .. count) stay in the map while the writer churns the rest */
+void *test_read_mostly_reader(void *arg)
+{
+	size_t ndx, lookups = 0, errors = 0;
+	struct test_hashmap *p;
+	struct test_read_mostly_ctx *ctx = arg;
+
+	while (!__atomic_load_n(&ctx->done, __ATOMIC_ACQUIRE)) {
+		for (ndx = 0; ndx < ctx->count; ndx++) {
+			p = hash_map_get(ctx->map, ctx->words[ndx], 0);
+			if (p == NULL || p->off != ndx)
+				errors++;
+		}
+		lookups += ctx->count;
+	}
+	__atomic_add_fetch(&ctx->lookups, lookups, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&ctx->errors, errors, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+int test_read_mostly(const char * const *words, size_t count)
+{
+	int i, rc = 0;
+	size_t stable = count / 2;
+	hash_map_t map;
+	hash_map_config_t config = { .flags = HASH_MAP_FLAG_READ_MOSTLY };
+	pthread_t readers[TEST_READ_MOSTLY_READERS];
+	struct test_read_mostly_ctx ctx = {
+		.map = &map, .words = words, .count = stable,
+	};
+
+	if (hash_map_init_config(&map, &config))
+		return -1;
+	if (test_dict(&map, words, count))
+		rc = -1;
+	hash_map_free(&map, free_test_hashmap_value);
+	if (rc)
+		return -1;
+
+	hash_map_init_config(&map, &config);
+	test_dict_insert(&map, words, stable);
+	for (i = 0; i < TEST_READ_MOSTLY_READERS; i++)
+		pthread_create(&readers[i], NULL, test_read_mostly_reader, &ctx);
+	/* the first round grows the map under the readers */
+	for (i = 0; i < 2; i++) {
+		if (test_dict_insert(&map, words + stable, count - stable) ||
+		    test_dict_delete(&map, words + stable, count - stable))
+			rc = -1;
+	}
+	__atomic_store_n(&ctx.done, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < TEST_READ_MOSTLY_READERS; i++)
+		pthread_join(readers[i], NULL);
+	if (ctx.errors || map.count != stable)
+		rc = -1;
+	mod_printf("Read mostly map: %zu lookups by %d readers, %zu errors",
+		   ctx.lookups, TEST_READ_MOSTLY_READERS, ctx.errors);
+	hash_map_free(&map, free_test_hashmap_value);
+	return rc;
+}
+
 TEST_DEF(hashmap)
 {
 	char *buf;
 	const char * const *words;
 	size_t size, count;
 	hash_map_t map;
+	hash_map_config_t config = { 0 };
 	TEST_MOD_INIT();
 
 	TEST_MOD_READ_FILE("words_alpha.txt", &buf, &size);
@@ -128,6 +613,93 @@ TEST_DEF(hashmap)
 	TEST_MOD_EXEC( test_dict_insert(&map, words, count) );
 	hash_map_free(&map, free_test_hashmap_value);
 
+	mod_printf("chained map with incremental rehash");
+	config.flags = HASH_MAP_FLAG_INCREMENTAL_REHASH;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict_migrating(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+
+	mod_printf("open addressing map");
+	config.flags = HASH_MAP_FLAG_NONE;
+	config.type = HASH_MAP_TYPE_OPEN;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+
+	mod_printf("open addressing map with borrowed keys");
+	config.flags = HASH_MAP_FLAG_BORROW_KEYS;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+
+	mod_printf("open addressing map with seeded wyhash");
+	config.flags = HASH_MAP_FLAG_RANDOM_SEED;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+
+	mod_printf("chained map with crc32c");
+	config.type = HASH_MAP_TYPE_CHAINED;
+	config.flags = HASH_MAP_FLAG_NONE;
+	config.hash_fn = hash_map_hash_crc32c;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+
+	mod_printf("chained map in an arena");
+	config.hash_fn = NULL;
+	config.flags = HASH_MAP_FLAG_ARENA;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+
+	mod_printf("open addressing map in an arena");
+	config.type = HASH_MAP_TYPE_OPEN;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+
+	mod_printf("ordered map");
+	config.type = HASH_MAP_TYPE_ORDERED;
+	config.flags = HASH_MAP_FLAG_NONE;
+	TEST_MOD_EXEC( hash_map_init_config(&map, &config) );
+	TEST_MOD_EXEC( test_dict(&map, words, count) );
+	hash_map_free(&map, free_test_hashmap_value);
+	TEST_MOD_EXEC( test_ordered(words, count) );
+
+	TEST_MOD_EXEC( test_u64_keys(HASH_MAP_TYPE_CHAINED) );
+	TEST_MOD_EXEC( test_u64_keys(HASH_MAP_TYPE_OPEN) );
+	TEST_MOD_EXEC( test_binary_keys(HASH_MAP_TYPE_CHAINED) );
+	TEST_MOD_EXEC( test_binary_keys(HASH_MAP_TYPE_OPEN) );
+	TEST_MOD_EXEC( test_u64_keys(HASH_MAP_TYPE_ORDERED) );
+	TEST_MOD_EXEC( test_binary_keys(HASH_MAP_TYPE_ORDERED) );
+	TEST_MOD_EXEC( test_dict_batch(HASH_MAP_TYPE_ORDERED, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_ORDERED, 0, 0.2, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_ORDERED,
+					HASH_MAP_FLAG_ARENA, 0, words, count) );
+	TEST_MOD_EXEC( test_dict_batch(HASH_MAP_TYPE_CHAINED, words, count) );
+	TEST_MOD_EXEC( test_dict_batch(HASH_MAP_TYPE_OPEN, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_CHAINED, 0, 0, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_CHAINED, 0, 0.2, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_OPEN, 0, 0, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_OPEN, 0, 0.2, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_CHAINED,
+					HASH_MAP_FLAG_READ_MOSTLY, 0.2, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_CHAINED,
+					HASH_MAP_FLAG_ARENA, 0, words, count) );
+	TEST_MOD_EXEC( test_dict_sizing(HASH_MAP_TYPE_OPEN,
+					HASH_MAP_FLAG_ARENA, 0, words, count) );
+	TEST_MOD_EXEC( test_shrink_boundary(HASH_MAP_TYPE_CHAINED, 0, words, count) );
+	TEST_MOD_EXEC( test_shrink_boundary(HASH_MAP_TYPE_OPEN, 0, words, count) );
+	TEST_MOD_EXEC( test_shrink_boundary(HASH_MAP_TYPE_ORDERED, 0, words, count) );
+	TEST_MOD_EXEC( test_shrink_boundary(HASH_MAP_TYPE_CHAINED,
+					    HASH_MAP_FLAG_READ_MOSTLY, words, count) );
+	TEST_MOD_EXEC( test_shard_map(words, count) );
+	TEST_MOD_EXEC( test_read_mostly(words, count) );
+
 	safe_free(buf);
 	safe_free((void *)words);
 	TEST_MOD_REPORT();
@@ -1,6 +1,11 @@
 #include "test.h"
+#include <string.h>
+#include <pthread.h>
 
 #include <utils/slab.h>
+#include <utils/memory.h>
+#include <utils/slab_cache.h>
+#include <utils/slab_pool.h>
 
 struct test_slab_blocks
 {
@@ -40,11 +45,333 @@ int test_slab_alloc_free()
 	return 0;
 }
 
+int test_slab_reuse()
+{
+	int i;
+	slab_t slab;
+	void *p[TEST_SLAB_COUNT], *q;
+	uint8_t slab_space[(sizeof(struct test_slab_blocks) + 8) * TEST_SLAB_COUNT];
+
+	if (slab_init(&slab, sizeof(struct test_slab_blocks),
+		      slab_space, sizeof(slab_space)) != TEST_SLAB_COUNT)
+		return -1;
+
+	for (i = 0; i < TEST_SLAB_COUNT; i++) {
+		if (slab_alloc(&slab, &p[i]))
+			return -1;
+	}
+	if (slab_alloc(&slab, &q) == 0)
+		return -1;
+
+	/* the most recently freed block is handed out first */
+	for (i = 0; i < TEST_SLAB_COUNT; i += 2) {
+		if (slab_free(&slab, p[i]))
+			return -1;
+		if (slab_alloc(&slab, &q) || q != p[i])
+			return -1;
+		if (slab_free(&slab, p[i]))
+			return -1;
+	}
+
+	/* double free and pointers not issued by slab are rejected */
+	if (slab_free(&slab, p[0]) == 0)
+		return -1;
+	if (slab_free(&slab, (uint8_t *)p[1] + 1) == 0)
+		return -1;
+	if (slab_free(&slab, slab_space) == 0)
+		return -1;
+
+	for (i = 1; i < TEST_SLAB_COUNT; i += 2) {
+		if (slab_free(&slab, p[i]))
+			return -1;
+	}
+	for (i = 0; i < TEST_SLAB_COUNT; i++) {
+		if (slab_alloc(&slab, &p[i]))
+			return -1;
+	}
+	return slab_alloc(&slab, &q) == 0 ? -1 : 0;
+}
+
+int test_slab_aligned()
+{
+	int i, count;
+	slab_t slab;
+	void *p, *q;
+	uint8_t blob[4096 + 100];
+
+	/* odd start and size; units must still land on 64 byte boundaries */
+	count = slab_init_aligned(&slab, 100, 64, blob + 1, sizeof(blob) - 1);
+	if (count <= 0 || slab.size != 128)
+		return -1;
+	/* and so must their records in the side array */
+	if (slab.meta_size != 64 || (uintptr_t)slab.blob % 64 != 0 ||
+	    slab.blob + count * 64 > slab.data)
+		return -1;
+	for (i = 0; i < count; i++) {
+		if (slab_alloc(&slab, &p) || (uintptr_t)p % 64 != 0)
+			return -1;
+		if (p < (void *)(blob + 1) ||
+		    (uint8_t *)p + 100 > blob + sizeof(blob))
+			return -1;
+		memset(p, 0xff, 128);
+	}
+	if (slab_alloc(&slab, &q) == 0)
+		return -1;
+	/* unit data is not used for book keeping, so free must still work */
+	if (slab_free(&slab, p) || slab_free(&slab, p) == 0)
+		return -1;
+	if (slab_alloc(&slab, &q) || q != p)
+		return -1;
+
+	if (slab_init_aligned(&slab, 100, 48, blob, sizeof(blob)) != -1)
+		return -1;
+	return 0;
+}
+
+int test_slab_huge_page()
+{
+	int i, count, rc = -1;
+	slab_t slab;
+	uint8_t *blob;
+	void *block;
+
+	/* node 0 exists on any Linux box; binding is best effort anyway */
+	blob = huge_page_alloc(HUGE_PAGE_SIZE, 0);
+	if ((uintptr_t)blob % HUGE_PAGE_SIZE != 0)
+		goto out;
+	count = slab_init(&slab, 1024, blob, HUGE_PAGE_SIZE);
+	if (count <= 0)
+		goto out;
+	for (i = 0; i < count; i++) {
+		if (slab_alloc(&slab, &block))
+			goto out;
+		memset(block, 0x5a, 1024);
+	}
+	if (slab_alloc(&slab, &block) == 0)
+		goto out;
+	rc = 0;
+out:
+	huge_page_free(blob, HUGE_PAGE_SIZE);
+	return rc;
+}
+
+#define TEST_SLAB_CACHE_BLOCKS    1024
+#define TEST_SLAB_CACHE_THREADS   4
+#define TEST_SLAB_CACHE_HELD      64
+#define TEST_SLAB_CACHE_ROUNDS    2000
+
+struct test_slab_cache {
+	slab_cache_t cache;
+	pthread_mutex_t lock;
+	void *mailbox[TEST_SLAB_CACHE_HELD];
+	int nr_mail;
+	int failed;
+};
+
+struct test_slab_cache_block {
+	long owner;
+	long seq;
+};
+
+static uint8_t test_slab_cache_space[2 * SLAB_CACHE_LINE_SIZE *
+				     TEST_SLAB_CACHE_BLOCKS + SLAB_CACHE_LINE_SIZE];
+
+static void *test_slab_cache_worker(void *arg)
+{
+	struct test_slab_cache *t = arg;
+	struct test_slab_cache_block *held[TEST_SLAB_CACHE_HELD];
+	long id = (long)pthread_self();
+	int i, r, n;
+
+	for (r = 0; r < TEST_SLAB_CACHE_ROUNDS && !t->failed; r++) {
+		n = 1 + r % TEST_SLAB_CACHE_HELD;
+		for (i = 0; i < n; i++) {
+			if (slab_cache_alloc(&t->cache, (void **)&held[i]))
+				break;
+			held[i]->owner = id;
+			held[i]->seq = i;
+		}
+		n = i;
+		/* a block handed out twice would have been overwritten */
+		for (i = 0; i < n; i++) {
+			if (held[i]->owner != id || held[i]->seq != i)
+				t->failed = 1;
+		}
+		/* pass every other block to some other thread to free */
+		pthread_mutex_lock(&t->lock);
+		for (i = 0; i < n; i += 2) {
+			if (t->nr_mail == TEST_SLAB_CACHE_HELD)
+				break;
+			t->mailbox[t->nr_mail++] = held[i];
+			held[i] = NULL;
+		}
+		i = n;
+		while (t->nr_mail > 0 && i-- > 0) {
+			if (held[i] == NULL)
+				held[i] = t->mailbox[--t->nr_mail];
+		}
+		pthread_mutex_unlock(&t->lock);
+		for (i = 0; i < n; i++) {
+			if (held[i] && slab_cache_free(&t->cache, held[i]))
+				t->failed = 1;
+		}
+	}
+	return NULL;
+}
+
+int test_slab_cache()
+{
+	int i;
+	void *block;
+	slab_t slab;
+	struct test_slab_cache t = { 0 };
+	pthread_t threads[TEST_SLAB_CACHE_THREADS];
+
+	/* cache line aligned so the threads don't false share blocks */
+	if (slab_init_aligned(&slab, sizeof(struct test_slab_cache_block),
+			      SLAB_CACHE_LINE_SIZE, test_slab_cache_space,
+			      sizeof(test_slab_cache_space)) <
+	    TEST_SLAB_CACHE_BLOCKS)
+		return -1;
+	if (slab_cache_init(&t.cache, &slab, 8))
+		return -1;
+	pthread_mutex_init(&t.lock, NULL);
+
+	for (i = 0; i < TEST_SLAB_CACHE_THREADS; i++)
+		pthread_create(&threads[i], NULL, test_slab_cache_worker, &t);
+	for (i = 0; i < TEST_SLAB_CACHE_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < t.nr_mail; i++)
+		slab_cache_free(&t.cache, t.mailbox[i]);
+	if (slab_cache_free(&t.cache, &slab) == 0)
+		return -1;
+	slab_cache_destroy(&t.cache);
+	pthread_mutex_destroy(&t.lock);
+	if (t.failed)
+		return -1;
+
+	/* every block must be back in the slab */
+	for (i = 0; i < TEST_SLAB_CACHE_BLOCKS; i++) {
+		if (slab_alloc(&slab, &block))
+			return -1;
+	}
+	return 0;
+}
+
+#ifndef NDEBUG
+/* slab_cache only catches double frees in debug builds */
+int test_slab_cache_double_free()
+{
+	int rc = -1;
+	void *a, *b, *c;
+	slab_t slab;
+	slab_cache_t cache;
+	static uint8_t space[64 * 16];
+
+	if (slab_init(&slab, 32, space, sizeof(space)) <= 0 ||
+	    slab_cache_init(&cache, &slab, 4))
+		return -1;
+
+	if (slab_cache_alloc(&cache, &a) || slab_cache_free(&cache, a))
+		goto out;
+	if (slab_cache_free(&cache, a) == 0) {
+		mod_printf("double free through the cache succeeded");
+		goto out;
+	}
+
+	/* the block can only be handed out once */
+	if (slab_cache_alloc(&cache, &b) || slab_cache_alloc(&cache, &c) ||
+	    b == c)
+		goto out;
+
+	/* a block parked in a magazine can't be released behind its back */
+	if (slab_cache_alloc(&cache, &a) || slab_cache_free(&cache, a) ||
+	    slab_free(&slab, a) == 0)
+		goto out;
+	rc = 0;
+out:
+	slab_cache_destroy(&cache);
+	return rc;
+}
+#endif
+
+#define TEST_SLAB_POOL_BLOCKS     2000
+
+int test_slab_pool()
+{
+	int i, rc = -1;
+	size_t j, size;
+	slab_pool_t pool;
+	uint8_t *p[TEST_SLAB_POOL_BLOCKS] = { 0 };
+	size_t sizes[TEST_SLAB_POOL_BLOCKS] = { 0 };
+
+	slab_pool_init(&pool);
+
+	/* sizes span every class and some large blocks */
+	for (i = 0; i < TEST_SLAB_POOL_BLOCKS; i++) {
+		size = (size_t)(i * 7919) % (SLAB_POOL_MAX_SIZE + 4096);
+		sizes[i] = size;
+		p[i] = slab_pool_malloc(&pool, size);
+		if ((uintptr_t)p[i] % 16 != 0 ||
+		    slab_pool_usable_size(p[i]) < size)
+			goto out;
+		memset(p[i], i & 0xff, size);
+	}
+
+	/* free every third block, then reallocate the rest */
+	for (i = 0; i < TEST_SLAB_POOL_BLOCKS; i += 3) {
+		slab_pool_free(&pool, p[i]);
+		p[i] = NULL;
+		sizes[i] = 0;
+	}
+	for (i = 1; i < TEST_SLAB_POOL_BLOCKS; i++) {
+		if (p[i] == NULL)
+			continue;
+		size = i % 2 ? sizes[i] / 2 : sizes[i] + 100;
+		p[i] = slab_pool_realloc(&pool, p[i], size);
+		for (j = 0; j < MIN(size, sizes[i]); j++) {
+			if (p[i][j] != (uint8_t)(i & 0xff))
+				goto out;
+		}
+		sizes[i] = size;
+		memset(p[i], i & 0xff, size);
+	}
+
+	/* a block handed out twice would have been overwritten */
+	for (i = 0; i < TEST_SLAB_POOL_BLOCKS; i++) {
+		for (j = 0; j < sizes[i]; j++) {
+			if (p[i][j] != (uint8_t)(i & 0xff))
+				goto out;
+		}
+	}
+
+	p[0] = (uint8_t *)slab_pool_strdup(&pool, "slab_pool");
+	if (strcmp((char *)p[0], "slab_pool") != 0)
+		goto out;
+	rc = 0;
+out:
+	for (i = 0; i < TEST_SLAB_POOL_BLOCKS; i++) {
+		if (sizes[i] > SLAB_POOL_MAX_SIZE)
+			slab_pool_free(&pool, p[i]);
+	}
+	slab_pool_destroy(&pool);
+	return rc;
+}
+
 TEST_DEF(slab)
 {
 	TEST_MOD_INIT();
 
 	TEST_MOD_EXEC( test_slab_alloc_free() );
+	TEST_MOD_EXEC( test_slab_reuse() );
+	TEST_MOD_EXEC( test_slab_aligned() );
+	TEST_MOD_EXEC( test_slab_huge_page() );
+	TEST_MOD_EXEC( test_slab_cache() );
+#ifndef NDEBUG
+	TEST_MOD_EXEC( test_slab_cache_double_free() );
+#endif
+	TEST_MOD_EXEC( test_slab_pool() );
 
 	TEST_MOD_REPORT();
 }
@@ -87,12 +87,32 @@ int test_str_copy()
 	return 0;
 }
 
+int test_str_create_arena()
+{
+	int rc = -1;
+	arena_t arena;
+	string_t s;
+
+	arena_init(&arena, 0);
+	string_create_arena(&arena, &s, "Hello", 5);
+	if (test_check_str(&s, "Hello"))
+		goto out;
+	if (string_resize(&s, 64) == 0)
+		goto out;
+	string_destroy(&s);
+	rc = 0;
+out:
+	arena_free(&arena);
+	return rc;
+}
+
 TEST_DEF(strlib)
 {
 	TEST_MOD_INIT();
 
 	TEST_MOD_EXEC(test_str_copy());
 	TEST_MOD_EXEC(test_str_printf());
+	TEST_MOD_EXEC(test_str_create_arena());
 
 	TEST_MOD_REPORT();
 }
@@ -1,4 +1,5 @@
 #include "test.h"
+#include <stdlib.h>
 #include <utils/utils.h>
 #include <utils/strutils.h>
 
@@ -58,12 +59,60 @@ int test_str_sep_count()
 	return 0;
 }
 
+int test_split_string_arena()
+{
+	int i, rc = -1;
+	char **toks, line[128];
+	void *first, *p;
+	arena_t arena;
+	arena_mark_t mark;
+
+	arena_init(&arena, 1024);
+
+	strcpy(line, "GET /index.html HTTP/1.1");
+	if (split_string_arena(&arena, line, " ", &toks) ||
+	    strcmp(toks[0], "GET") || strcmp(toks[2], "HTTP/1.1") ||
+	    toks[3] != NULL)
+		goto out;
+
+	/* rewind gives back everything allocated after the mark */
+	mark = arena_mark(&arena);
+	first = arena_alloc(&arena, 16);
+	for (i = 0; i < 100; i++) {
+		snprintf(line, sizeof(line), "a,b,c,%d", i);
+		if (split_string_arena(&arena, line, ",", &toks) ||
+		    atoi(toks[3]) != i)
+			goto out;
+	}
+	memset(arena_alloc(&arena, 4096), 0xa5, 4096);
+	arena_rewind(&arena, mark);
+	if (arena_alloc(&arena, 16) != first || arena.large != NULL)
+		goto out;
+
+	strcpy(line, ",,,");
+	if (split_string_arena(&arena, line, ",", &toks) == 0)
+		goto out;
+
+	/* reset keeps a chunk and starts over from its beginning */
+	arena_reset(&arena);
+	first = arena_alloc(&arena, 16);
+	arena_reset(&arena);
+	p = arena_alloc(&arena, 16);
+	if (p != first)
+		goto out;
+	rc = 0;
+out:
+	arena_free(&arena);
+	return rc;
+}
+
 TEST_DEF(strutils)
 {
 	TEST_MOD_INIT();
 
 	TEST_MOD_EXEC(test_str_sep());
 	TEST_MOD_EXEC(test_str_sep_count());
+	TEST_MOD_EXEC(test_split_string_arena());
 
 	TEST_MOD_REPORT();
 }
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <pthread.h>
 
+#include <utils/utils.h>
 #include <utils/workqueue.h>
 
 struct test_work_data {
@@ -51,7 +52,7 @@ int test_workqueue()
 		workqueue_add_work(&wq, &work[i]);
 	}
 
-	while (num_complete != NUM_JOBS);
+	while (READ_ONCE(num_complete) != NUM_JOBS);
 	mod_printf("Completed %d jobs", NUM_JOBS);
 
 	workqueue_destroy(&wq);
@@ -59,11 +60,72 @@ int test_workqueue()
 	return 0;
 }
 
+#define MPSC_PRODUCERS 4
+#define MPSC_ITEMS 50000
+
+struct test_mpsc_item {
+	queue_node_t node;
+	int producer;
+	int seq;
+};
+
+queue_mpsc_t test_mpsc_queue;
+struct test_mpsc_item test_mpsc_items[MPSC_PRODUCERS][MPSC_ITEMS];
+
+void *test_mpsc_producer(void *arg)
+{
+	int i, id = (int)(intptr_t)arg;
+	struct test_mpsc_item *item;
+
+	for (i = 0; i < MPSC_ITEMS; i++) {
+		item = &test_mpsc_items[id][i];
+		item->producer = id;
+		item->seq = i;
+		queue_mpsc_enqueue(&test_mpsc_queue, &item->node);
+	}
+	return NULL;
+}
+
+int test_queue_mpsc()
+{
+	intptr_t i;
+	int count = 0, errors = 0, next[MPSC_PRODUCERS] = {0};
+	pthread_t producers[MPSC_PRODUCERS];
+	queue_node_t *node;
+	struct test_mpsc_item *item;
+
+	queue_mpsc_init(&test_mpsc_queue);
+	if (queue_mpsc_dequeue(&test_mpsc_queue, &node) == 0)
+		return -1;
+
+	for (i = 0; i < MPSC_PRODUCERS; i++)
+		pthread_create(&producers[i], NULL, test_mpsc_producer, (void *)i);
+
+	/* FIFO: each producer's items come out in the order they went in */
+	while (count < MPSC_PRODUCERS * MPSC_ITEMS) {
+		if (queue_mpsc_dequeue(&test_mpsc_queue, &node))
+			continue;
+		item = CONTAINER_OF(node, struct test_mpsc_item, node);
+		if (item->seq != next[item->producer]++)
+			errors++;
+		count++;
+	}
+
+	for (i = 0; i < MPSC_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+
+	mod_printf("Dequeued %d items from %d producers", count, MPSC_PRODUCERS);
+	if (queue_mpsc_dequeue(&test_mpsc_queue, &node) == 0)
+		return -1;
+	return errors ? -1 : 0;
+}
+
 TEST_DEF(workqueue)
 {
 	TEST_MOD_INIT();
 
 	TEST_MOD_EXEC( test_workqueue() );
+	TEST_MOD_EXEC( test_queue_mpsc() );
 
 	TEST_MOD_REPORT();
 }
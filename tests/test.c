@@ -65,6 +65,7 @@ static const char *TEST_HELP_TEXT =
 	"\n"
 	"OPTIONS:\n"
 	"  -i   Input files directory\n"
+	"  -b   Also run the (slow) benchmarks\n"
 	"  -h   Print this help text\n"
 	"\n";
 
@@ -74,11 +75,12 @@ void process_cli_opts(test_t *ctx, int argc, char *argv[])
 	int opt_ndx;
 	static struct option opts[] = {
 		{ "inputdir",   required_argument, NULL,                   'i' },
+		{ "bench",      no_argument,       NULL,                   'b' },
 		{ "help",       no_argument,       NULL,                   'h' },
 		{ NULL,         0,                 NULL,                    0  }
 	};
 	const char *opt_str =
-		/* no_argument       */ "h"
+		/* no_argument       */ "hb"
 		/* required_argument */ "i:"
 		;
 	while ((c = getopt_long(argc, argv, opt_str, opts, &opt_ndx)) >= 0) {
@@ -90,6 +92,9 @@ void process_cli_opts(test_t *ctx, int argc, char *argv[])
 			}
 			ctx->inputdir = safe_strdup(optarg);
 			break;
+		case 'b':
+			ctx->bench = true;
+			break;
 		case 'h':
 			printf("%s", TEST_HELP_TEXT);
 			exit(0);
@@ -134,6 +139,7 @@ int main(int argc, char *argv[])
 {
 	test_module_t *tm;
 	test_t test;
+	memory_stats_t mem_stats;
 
 	memset(&test, 0, sizeof(test_t));
 	process_cli_opts(&test, argc, argv);
@@ -165,5 +171,13 @@ int main(int argc, char *argv[])
 	printf("Executed: %d\n", test.total);
 	printf("Successful: %d\n", test.pass);
 	printf("Result: %s\n\n", (test.total == test.pass) ? "PASS" : "FAIL");
+
+	// Allocation stats (only when built with USE_MEMORY_STATS)
+	if (memory_stats_get(&mem_stats) == 0) {
+		printf("------------------------------------------\n");
+		printf("              Memory Summary              \n");
+		printf("------------------------------------------\n");
+		memory_stats_dump(stdout);
+	}
 	return 0;
 }
@@ -34,6 +34,7 @@ typedef struct
 
 typedef struct {
 	char *inputdir;
+	bool bench;
 	time_t start_time;
 	time_t end_time;
 	int total;